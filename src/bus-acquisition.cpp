@@ -0,0 +1,373 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "bus-acquisition.hpp"
+#include "realtime.hpp"
+
+BusAcquisition::BusAcquisition(I2cBus &bus,
+                               AcquisitionOptions const &options) noexcept
+    : m_options(options),
+      m_array{bus},
+      m_scheduler{options.freq, options.overrunPolicy},
+      m_slotCount{1},
+      m_slot{0},
+      m_forwardMask{0},
+      m_groundSpeed{0.0f},
+      m_groundSpeedChanged{true},
+      m_maxRanges{},
+      m_round{0},
+      m_longWindow{false},
+      m_shortRanges{},
+      m_requests{},
+      m_requestedRanges{},
+      m_requestedGains{},
+      m_publish{},
+      m_afterCycle{},
+      m_collect{[this](Srf08 &sensor, Srf08Echoes const &echoes) {
+        if (nullptr != m_publish) {
+          m_publish(sensor, echoes);
+        }
+        control(sensor, echoes);
+      }},
+      m_controllers{},
+      m_thread{} {}
+
+uint32_t const BusAcquisition::REQUEST_CAPACITY;
+
+BusAcquisition::~BusAcquisition() { join(); }
+
+Srf08Array &BusAcquisition::array() noexcept { return m_array; }
+
+DeadlineScheduler const &BusAcquisition::scheduler() const noexcept {
+  return m_scheduler;
+}
+
+void BusAcquisition::setSlotCount(uint32_t slotCount) noexcept {
+  m_slotCount = (slotCount > 0) ? slotCount : 1;
+}
+
+void BusAcquisition::setForwardMask(uint32_t forwardMask) noexcept {
+  m_forwardMask = forwardMask;
+}
+
+void BusAcquisition::setGroundSpeed(float groundSpeed) noexcept {
+  m_groundSpeed.store(groundSpeed, std::memory_order_relaxed);
+  m_groundSpeedChanged.store(true, std::memory_order_release);
+}
+
+bool BusAcquisition::setFrequency(float freq) noexcept {
+  if (nullptr != m_options.speedCurve || freq <= 0.0f) {
+    return false;
+  }
+  m_scheduler.setFrequency(freq);
+  return true;
+}
+
+BusAcquisition::Request BusAcquisition::configure(
+    SensorConfiguration const &configuration) noexcept {
+  /* Only ever called from one thread, the single producer of the request
+   * queue. A request for all sensors takes a single entry. A range that
+   * reaches the long window would be mistaken for it. */
+  if (configuration.range > 255 || configuration.gain > srf08::MAX_GAIN ||
+      (m_options.longEvery > 0 &&
+       configuration.range >= static_cast<int64_t>(m_options.longRange))) {
+    return Request::Invalid;
+  }
+  auto const &sensors = m_array.sensors();
+  if (configuration.id >= 0 &&
+      std::none_of(sensors.begin(), sensors.end(),
+                   [&configuration](std::unique_ptr<Srf08> const &sensor) {
+                     return sensor->id() == configuration.id;
+                   })) {
+    return Request::Invalid;
+  }
+  return m_requests.push(configuration) ? Request::Queued
+                                        : Request::QueueFull;
+}
+
+bool BusAcquisition::cycle() noexcept {
+  std::function<void(Srf08 &, Srf08Echoes const &)> const &collect{
+      m_controllers.empty() ? m_publish : m_collect};
+  auto fire{[this]() {
+    applyWindow();
+    return m_options.broadcast ? m_array.fireBroadcast()
+                               : m_array.fire(m_slot);
+  }};
+  if (m_options.pipelined) {
+    /* The ping fired in the previous cycle has had a whole period to
+     * complete. Collect it and fire the next one immediately, so that
+     * ranging overlaps the wait for the next cycle. */
+    if (m_options.poll) {
+      m_array.waitForRanging(m_options.pollInterval,
+                             std::chrono::duration<double, std::milli>{0});
+    } else {
+      m_array.markReady();
+    }
+    m_array.collect(collect);
+    fire();
+  } else {
+    if (fire() > 0) {
+      return false;
+    }
+    if (m_options.poll) {
+      uint32_t const pending{m_array.waitForRanging(m_options.pollInterval,
+                                                    m_options.pollTimeout)};
+      if (pending > 0) {
+        std::cerr << "Ranging did not complete within "
+                  << m_options.pollTimeout.count() << " ms on " << pending
+                  << " device(s) on " << m_array.bus().devNode() << "."
+                  << std::endl;
+      }
+    } else {
+      /* The wait follows the longest range window as the registers are
+       * now, whichever of --range, adaptive control, the ground speed, a
+       * long round or a runtime request has set them. The margin makes it
+       * 70 ms for the full window. */
+      std::this_thread::sleep_for(m_array.rangingTime() +
+                                  std::chrono::microseconds{5000});
+      m_array.markReady();
+    }
+    if (m_array.collect(collect) > 0 && !m_options.poll) {
+      return false;
+    }
+  }
+  m_slot = (m_slot + 1) % m_slotCount;
+  if (m_slot == 0) {
+    m_round++;
+  }
+  return true;
+}
+
+void BusAcquisition::start(
+    std::function<void(Srf08 &, Srf08Echoes const &)> publish,
+    std::function<bool()> afterCycle) {
+  m_publish = publish;
+  m_afterCycle = afterCycle;
+  m_maxRanges.clear();
+  for (auto &sensor : m_array.sensors()) {
+    m_maxRanges.push_back(sensor->range());
+  }
+  m_shortRanges = m_maxRanges;
+  m_requestedRanges.assign(m_maxRanges.size(), -1);
+  m_requestedGains.assign(m_maxRanges.size(), -1);
+  m_controllers.clear();
+  if (m_options.adaptive) {
+    for (auto &sensor : m_array.sensors()) {
+      m_controllers.emplace_back(new GainRangeController{
+          sensor->range(), sensor->gain(), m_options.adaptiveWindow});
+    }
+  }
+  m_thread = std::thread(&BusAcquisition::run, this);
+}
+
+void BusAcquisition::join() noexcept {
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void BusAcquisition::run() noexcept {
+  std::string const &devNode{m_array.bus().devNode()};
+  if (m_options.realtime) {
+    /* Scheduling policy, affinity and the pre-faulted stack all belong to
+     * this thread only. */
+    std::clog << "Real-time mode on " << devNode << ": SCHED_FIFO priority "
+              << m_options.rtPriority
+              << (realtime::setFifoPriority(m_options.rtPriority) ? " set"
+                                                                  : " failed")
+              << ", ";
+    if (m_options.rtCpu >= 0) {
+      std::clog << "pinning to CPU " << m_options.rtCpu
+                << (realtime::pinToCpu(m_options.rtCpu) ? " done" : " failed")
+                << ", ";
+    } else {
+      std::clog << "no CPU pinning, ";
+    }
+    realtime::prefaultStack();
+    std::clog << "pre-faulted " << realtime::PREFAULT_STACK_SIZE / 1024
+              << " KiB of stack." << std::endl;
+  }
+
+  m_scheduler.run([this]() -> bool { return cycle() && m_afterCycle(); });
+  std::clog << "Ran " << m_scheduler.cycles() << " cycles on " << devNode
+            << ", missed " << m_scheduler.missedDeadlines()
+            << " deadlines and skipped " << m_scheduler.skippedCycles()
+            << " cycles." << std::endl;
+}
+
+void BusAcquisition::control(Srf08 &sensor,
+                             Srf08Echoes const &echoes) noexcept {
+  /* A register write that fails is retried after the next ping. */
+  auto &sensors = m_array.sensors();
+  for (uint32_t i = 0; i < m_controllers.size(); i++) {
+    if (sensors[i].get() != &sensor) {
+      continue;
+    }
+    if (isLongWindow(echoes)) {
+      /* The long window is not controlled, and is left as it is until the
+       * next round restores the short one. */
+      return;
+    }
+    GainRangeController &controller = *m_controllers[i];
+    controller.observe(echoes);
+    m_shortRanges[i] = controller.range();
+    if (!m_longWindow && controller.range() != sensor.range()) {
+      sensor.writeRange(controller.range());
+    }
+    if (controller.gain() != sensor.gain()) {
+      sensor.writeGain(controller.gain());
+    }
+    return;
+  }
+}
+
+void BusAcquisition::applyConfiguration() noexcept {
+  /* Requests queued since the last firing are merged per sensor first, in
+   * queue order whether they name a sensor or all of them, so that each
+   * register is written at most once. Requests queued before start() wait
+   * for the first firing. */
+  auto &sensors = m_array.sensors();
+  if (m_requestedRanges.size() != sensors.size()) {
+    return;
+  }
+  bool requested{false};
+  SensorConfiguration request;
+  while (m_requests.pop(request)) {
+    for (uint32_t i = 0; i < m_requestedRanges.size(); i++) {
+      if (request.id < 0 || sensors[i]->id() == request.id) {
+        m_requestedRanges[i] = (request.range >= 0)
+                                   ? static_cast<int32_t>(request.range)
+                                   : m_requestedRanges[i];
+        m_requestedGains[i] = (request.gain >= 0)
+                                  ? static_cast<int32_t>(request.gain)
+                                  : m_requestedGains[i];
+        requested = true;
+      }
+    }
+  }
+  if (!requested) {
+    return;
+  }
+  for (uint32_t i = 0; i < m_requestedRanges.size(); i++) {
+    Srf08 &sensor = *sensors[i];
+    if (m_requestedRanges[i] >= 0) {
+      uint8_t const range{static_cast<uint8_t>(m_requestedRanges[i])};
+      m_requestedRanges[i] = -1;
+      m_maxRanges[i] = range;
+      if (nullptr != m_options.speedCurve) {
+        m_groundSpeedChanged.store(true, std::memory_order_relaxed);
+      } else if (!m_controllers.empty()) {
+        m_controllers[i]->setMaxRange(range);
+        m_shortRanges[i] = m_controllers[i]->range();
+      } else {
+        m_shortRanges[i] = range;
+      }
+      if (!m_longWindow && m_shortRanges[i] != sensor.range()) {
+        sensor.writeRange(m_shortRanges[i]);
+      }
+    }
+    if (m_requestedGains[i] >= 0) {
+      uint8_t gain{static_cast<uint8_t>(m_requestedGains[i])};
+      m_requestedGains[i] = -1;
+      if (!m_controllers.empty()) {
+        m_controllers[i]->setMaxGain(gain);
+        gain = m_controllers[i]->gain();
+      }
+      if (gain != sensor.gain()) {
+        sensor.writeGain(gain);
+      }
+    }
+  }
+}
+
+void BusAcquisition::applyGroundSpeed() noexcept {
+  /* Runs right before firing, when every sensor about to fire is idle and
+   * listens to register writes. */
+  auto &sensors = m_array.sensors();
+  if (nullptr == m_options.speedCurve ||
+      m_maxRanges.size() != sensors.size() ||
+      !m_groundSpeedChanged.exchange(false, std::memory_order_acquire)) {
+    return;
+  }
+  SpeedCurve const &curve = *m_options.speedCurve;
+  float const speed{m_groundSpeed.load(std::memory_order_relaxed)};
+  float const rate{curve.rate(speed)};
+  m_scheduler.setFrequency(rate);
+  uint32_t const divider{static_cast<uint32_t>(
+      std::max(1L, std::lround(rate / curve.rate(0.0f))))};
+  for (uint32_t i = 0; i < sensors.size(); i++) {
+    bool const forward{m_forwardMask == 0 || (m_forwardMask & (1U << i)) != 0};
+    m_array.setDivider(i, forward ? 1 : divider);
+    uint8_t const range{std::min(
+        GainRangeController::rangeRegister(
+            curve.window(forward ? speed : 0.0f)),
+        m_maxRanges[i])};
+    if (!m_controllers.empty()) {
+      m_controllers[i]->setMaxRange(range);
+      continue;
+    }
+    m_shortRanges[i] = range;
+    if (!m_longWindow && range != sensors[i]->range() &&
+        !sensors[i]->writeRange(range)) {
+      m_groundSpeedChanged.store(true, std::memory_order_relaxed);
+    }
+  }
+}
+
+void BusAcquisition::applyWindow() noexcept {
+  /* Before every firing, requested register values are applied, and a
+   * round after the long one restores the short windows before the ground
+   * speed, so that a new ground speed then replaces the restored value.
+   * Each sensor's short window is kept in m_shortRanges, which is what
+   * control, configuration and ground speed update, whichever window the
+   * register holds. Writes only happen where a register differs from the
+   * window of the round. A restore that fails keeps the long window set,
+   * so that it is retried before the next firing. */
+  applyConfiguration();
+  auto &sensors = m_array.sensors();
+  bool const longRound{m_options.longEvery > 0 &&
+                       m_shortRanges.size() == sensors.size() &&
+                       m_round % m_options.longEvery ==
+                           m_options.longEvery - 1};
+  if (m_longWindow && !longRound) {
+    bool restored{true};
+    for (uint32_t i = 0; i < sensors.size(); i++) {
+      if (sensors[i]->range() != m_shortRanges[i] &&
+          !sensors[i]->writeRange(m_shortRanges[i])) {
+        restored = false;
+      }
+    }
+    m_longWindow = !restored;
+  }
+  applyGroundSpeed();
+  if (longRound) {
+    m_longWindow = true;
+    for (uint32_t i = 0; i < sensors.size(); i++) {
+      if (sensors[i]->range() != m_options.longRange) {
+        sensors[i]->writeRange(m_options.longRange);
+      }
+    }
+  }
+}
+
+bool BusAcquisition::isLongWindow(Srf08Echoes const &echoes) const noexcept {
+  return m_options.longEvery > 0 && echoes.range == m_options.longRange;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUS_ACQUISITION_HPP
+#define BUS_ACQUISITION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "deadline-scheduler.hpp"
+#include "gain-range-controller.hpp"
+#include "i2c-bus.hpp"
+#include "speed-curve.hpp"
+#include "spsc-ring.hpp"
+#include "srf08-array.hpp"
+
+struct AcquisitionOptions {
+  float freq{10.0f};
+  DeadlineScheduler::OverrunPolicy overrunPolicy{
+      DeadlineScheduler::OverrunPolicy::Skip};
+  bool pipelined{false};
+  bool broadcast{false};
+  bool poll{false};
+  std::chrono::duration<double, std::milli> pollInterval{0.0};
+  std::chrono::duration<double, std::milli> pollTimeout{70.0};
+  bool realtime{false};
+  int32_t rtPriority{50};
+  int32_t rtCpu{-1}; /* Negative for no pinning */
+  bool adaptive{false};        /* Control gain and range from the echoes */
+  uint32_t adaptiveWindow{20}; /* Pings per control step */
+  /* nullptr for a fixed rate and range */
+  SpeedCurve const *speedCurve{nullptr};
+  uint8_t longRange{255}; /* Range register of the long window */
+  uint32_t longEvery{0};  /* Rounds per long-window round, 0 for none */
+};
+
+/* New register values for one sensor, or for every sensor of the bus with
+ * a negative id, where a negative value keeps the current one. The fields
+ * are wide enough for any unsigned 32-bit value of a request, which is
+ * then checked against the register bounds. */
+struct SensorConfiguration {
+  int64_t id{-1};
+  int64_t range{-1};
+  int64_t gain{-1};
+};
+
+/* The acquisition loop of one I2C bus, run by its own thread so that
+ * several buses progress in parallel. Every cycle fires the next firing
+ * slot of the array and collects the results into the publish delegate.
+ * After each cycle the afterCycle delegate decides whether to go on. With
+ * adaptive control, each sensor gets a GainRangeController whose register
+ * values are written right after its echoes are collected, while it is
+ * idle. With a speed curve, the ground speed set from any thread decides
+ * the cycle rate and the range window of the forward sensors before the
+ * next firing; the other sensors stay at their standstill rate and window.
+ * Without forward sensors, all of them follow the ground speed. With a
+ * long window, every longEvery-th round through the firing slots pings
+ * with the long range, and the next round restores each sensor's own.
+ *
+ * Range and gain may be reconfigured at runtime from one other thread.
+ * Requests are queued without locking and applied right before the next
+ * firing, in place of the values the sensor was set up with, and thus as
+ * limits under adaptive control and a speed curve. A register is only
+ * written when its value changes. Under a speed curve, the curve alone
+ * sets the cycle rate. */
+class BusAcquisition {
+ private:
+  BusAcquisition(BusAcquisition const &) = delete;
+  BusAcquisition(BusAcquisition &&) = delete;
+  BusAcquisition &operator=(BusAcquisition const &) = delete;
+  BusAcquisition &operator=(BusAcquisition &&) = delete;
+
+ public:
+  enum class Request { Queued, Invalid, QueueFull };
+
+ public:
+  BusAcquisition(I2cBus &bus, AcquisitionOptions const &options) noexcept;
+  ~BusAcquisition();
+
+ public:
+  Srf08Array &array() noexcept;
+  DeadlineScheduler const &scheduler() const noexcept;
+  void setSlotCount(uint32_t slotCount) noexcept;
+  void setForwardMask(uint32_t forwardMask) noexcept;
+  void setGroundSpeed(float groundSpeed) noexcept;
+  bool setFrequency(float freq) noexcept;
+  Request configure(SensorConfiguration const &configuration) noexcept;
+  bool cycle() noexcept;
+  void start(std::function<void(Srf08 &, Srf08Echoes const &)> publish,
+             std::function<bool()> afterCycle);
+  void join() noexcept;
+
+ public:
+  static uint32_t const REQUEST_CAPACITY{16};
+
+ private:
+  void run() noexcept;
+  void control(Srf08 &sensor, Srf08Echoes const &echoes) noexcept;
+  void applyConfiguration() noexcept;
+  void applyGroundSpeed() noexcept;
+  void applyWindow() noexcept;
+  bool isLongWindow(Srf08Echoes const &echoes) const noexcept;
+
+ private:
+  AcquisitionOptions m_options;
+  Srf08Array m_array;
+  DeadlineScheduler m_scheduler;
+  uint32_t m_slotCount;
+  uint32_t m_slot;
+  uint32_t m_forwardMask;
+  std::atomic<float> m_groundSpeed;
+  std::atomic<bool> m_groundSpeedChanged;
+  std::vector<uint8_t> m_maxRanges;
+  uint32_t m_round;
+  bool m_longWindow;
+  std::vector<uint8_t> m_shortRanges;
+  SpscRing<SensorConfiguration, REQUEST_CAPACITY> m_requests;
+  std::vector<int32_t> m_requestedRanges;
+  std::vector<int32_t> m_requestedGains;
+  std::function<void(Srf08 &, Srf08Echoes const &)> m_publish;
+  std::function<bool()> m_afterCycle;
+  std::function<void(Srf08 &, Srf08Echoes const &)> m_collect;
+  std::vector<std::unique_ptr<GainRangeController>> m_controllers;
+  std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <ctime>
+
+#include "deadline-scheduler.hpp"
+
+namespace {
+int64_t const NANOSECONDS_PER_SECOND{1000000000LL};
+
+double periodInNanoseconds(float freq) noexcept {
+  return static_cast<double>(NANOSECONDS_PER_SECOND) /
+         ((freq > 0) ? static_cast<double>(freq) : 1.0);
+}
+
+int64_t monotonicNow() noexcept {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * NANOSECONDS_PER_SECOND + ts.tv_nsec;
+}
+
+void sleepUntil(int64_t deadline) noexcept {
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(deadline / NANOSECONDS_PER_SECOND);
+  ts.tv_nsec = static_cast<long>(deadline % NANOSECONDS_PER_SECOND);
+  /* An absolute deadline can simply be retried after a signal. */
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) ==
+         EINTR) {
+  }
+}
+}  // namespace
+
+DeadlineScheduler::DeadlineScheduler(float freq, OverrunPolicy policy) noexcept
+    : m_periodInNanoseconds{periodInNanoseconds(freq)},
+      m_requestedPeriod{m_periodInNanoseconds},
+      m_periodChanged{false},
+      m_policy{policy},
+      m_cycles{0},
+      m_missedDeadlines{0},
+      m_skippedCycles{0} {}
+
+bool DeadlineScheduler::parsePolicy(std::string const &name,
+                                    OverrunPolicy &policy) noexcept {
+  if (name == "catch-up") {
+    policy = OverrunPolicy::CatchUp;
+    return true;
+  }
+  if (name == "skip") {
+    policy = OverrunPolicy::Skip;
+    return true;
+  }
+  return false;
+}
+
+void DeadlineScheduler::run(std::function<bool()> delegate) noexcept {
+  if (nullptr == delegate) {
+    return;
+  }
+  int64_t start{monotonicNow()};
+  uint64_t k{0};
+  bool delegateIsRunning{true};
+  while (true) {
+    try {
+      delegateIsRunning = delegate();
+    } catch (...) {
+      delegateIsRunning = false;
+    }
+    m_cycles++;
+    if (!delegateIsRunning) {
+      break;
+    }
+    k++;
+    if (m_periodChanged.exchange(false, std::memory_order_acquire)) {
+      /* Re-anchor at the deadline just passed, so that the new period
+       * counts from there without drift. */
+      start += std::llround(static_cast<double>(k - 1) *
+                            m_periodInNanoseconds);
+      k = 1;
+      m_periodInNanoseconds =
+          m_requestedPeriod.load(std::memory_order_relaxed);
+    }
+
+    int64_t deadline{start + std::llround(static_cast<double>(k) *
+                                          m_periodInNanoseconds)};
+    int64_t const now{monotonicNow()};
+    if (now > deadline) {
+      m_missedDeadlines++;
+      if (m_policy == OverrunPolicy::Skip) {
+        /* Continue at the next deadline still ahead, keeping the phase. */
+        uint64_t const behind{static_cast<uint64_t>(
+            static_cast<double>(now - deadline) / m_periodInNanoseconds)};
+        k += behind + 1;
+        m_skippedCycles += behind + 1;
+        deadline = start + std::llround(static_cast<double>(k) *
+                                        m_periodInNanoseconds);
+      } else {
+        continue;
+      }
+    }
+    sleepUntil(deadline);
+  }
+}
+
+void DeadlineScheduler::setFrequency(float freq) noexcept {
+  m_requestedPeriod.store(periodInNanoseconds(freq),
+                          std::memory_order_relaxed);
+  m_periodChanged.store(true, std::memory_order_release);
+}
+
+uint64_t DeadlineScheduler::cycles() const noexcept { return m_cycles; }
+
+uint64_t DeadlineScheduler::missedDeadlines() const noexcept {
+  return m_missedDeadlines;
+}
+
+uint64_t DeadlineScheduler::skippedCycles() const noexcept {
+  return m_skippedCycles;
+}
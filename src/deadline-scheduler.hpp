@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEADLINE_SCHEDULER_HPP
+#define DEADLINE_SCHEDULER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/* Calls a delegate periodically at absolute deadlines on CLOCK_MONOTONIC.
+ * Deadline k is start + k * period computed in nanoseconds, so rounding
+ * never accumulates into drift. After an overrun the scheduler either runs
+ * the missed cycles back to back (CatchUp) or drops them and continues at
+ * the next deadline still in the future (Skip). A new frequency, which may
+ * be set from any thread, takes effect from the next deadline on. */
+class DeadlineScheduler {
+ private:
+  DeadlineScheduler(DeadlineScheduler const &) = delete;
+  DeadlineScheduler(DeadlineScheduler &&) = delete;
+  DeadlineScheduler &operator=(DeadlineScheduler const &) = delete;
+  DeadlineScheduler &operator=(DeadlineScheduler &&) = delete;
+
+ public:
+  enum class OverrunPolicy { CatchUp, Skip };
+
+ public:
+  DeadlineScheduler(float freq, OverrunPolicy policy) noexcept;
+
+ public:
+  static bool parsePolicy(std::string const &name,
+                          OverrunPolicy &policy) noexcept;
+  void run(std::function<bool()> delegate) noexcept;
+  void setFrequency(float freq) noexcept;
+  uint64_t cycles() const noexcept;
+  uint64_t missedDeadlines() const noexcept;
+  uint64_t skippedCycles() const noexcept;
+
+ private:
+  double m_periodInNanoseconds;
+  std::atomic<double> m_requestedPeriod;
+  std::atomic<bool> m_periodChanged;
+  OverrunPolicy m_policy;
+  uint64_t m_cycles;
+  uint64_t m_missedDeadlines;
+  uint64_t m_skippedCycles;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ncurses.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "display.hpp"
+
+Display::Display(float freq) noexcept
+    : m_freq{(freq > 0) ? freq : 1.0f},
+      m_latest{},
+      m_snapshots{},
+      m_running{true},
+      m_thread{} {
+  m_thread = std::thread(&Display::run, this);
+}
+
+Display::~Display() {
+  m_running.store(false);
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+void Display::update(uint32_t id, Srf08Echoes const &echoes) noexcept {
+  uint32_t i{0};
+  while (i < m_latest.count && m_latest.sensors[i].id != id) {
+    i++;
+  }
+  if (i == m_latest.count) {
+    if (m_latest.count == srf08::MAX_SENSORS_PER_BUS) {
+      return;
+    }
+    m_latest.count++;
+  }
+  m_latest.sensors[i].id = id;
+  m_latest.sensors[i].echoes = echoes;
+}
+
+void Display::commit() noexcept {
+  m_latest.cycle++;
+  m_snapshots.back() = m_latest;
+  m_snapshots.publish();
+}
+
+void Display::run() noexcept {
+  /* Lowest priority for this thread only, the acquisition thread is not
+   * affected. */
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+
+  initscr();
+  std::chrono::duration<double> const period{1.0 / m_freq};
+  while (m_running.load()) {
+    if (m_snapshots.update()) {
+      SampleSnapshot const &snapshot = m_snapshots.front();
+      clear();
+      int32_t row{1};
+      mvprintw(row++, 1, "cycle %llu",
+               static_cast<unsigned long long>(snapshot.cycle));
+      for (uint32_t n = 0; n < snapshot.count; n++) {
+        SensorSnapshot const &sensor = snapshot.sensors[n];
+        mvprintw(row++, 1, "sensor %u, size of data: %u", sensor.id,
+                 static_cast<uint32_t>(sensor.echoes.count));
+        for (uint8_t i = 0; i < sensor.echoes.count; i++) {
+          mvprintw(row++, 3, "%u: %f", static_cast<uint32_t>(i),
+                   static_cast<double>(sensor.echoes.distances[i]));
+        }
+      }
+      refresh(); /* Print it on to the real screen */
+    }
+    std::this_thread::sleep_for(period);
+  }
+  endwin(); /* End curses mode      */
+}
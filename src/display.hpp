@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DISPLAY_HPP
+#define DISPLAY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "srf08.hpp"
+#include "triple-buffer.hpp"
+
+struct SensorSnapshot {
+  uint32_t id;
+  Srf08Echoes echoes;
+};
+
+struct SampleSnapshot {
+  uint64_t cycle;
+  uint32_t count;
+  SensorSnapshot sensors[srf08::MAX_SENSORS_PER_BUS];
+};
+
+/* ncurses view of the latest echoes, rendered by its own low-priority thread
+ * at its own refresh rate. The acquisition thread only copies its samples
+ * into a triple buffer, so a slow terminal cannot stretch a cycle. */
+class Display {
+ private:
+  Display(Display const &) = delete;
+  Display(Display &&) = delete;
+  Display &operator=(Display const &) = delete;
+  Display &operator=(Display &&) = delete;
+
+ public:
+  explicit Display(float freq) noexcept;
+  ~Display();
+
+ public:
+  void update(uint32_t id, Srf08Echoes const &echoes) noexcept;
+  void commit() noexcept;
+
+ private:
+  void run() noexcept;
+
+ private:
+  float m_freq;
+  SampleSnapshot m_latest;
+  TripleBuffer<SampleSnapshot> m_snapshots;
+  std::atomic<bool> m_running;
+  std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "envelope-encoder.hpp"
+
+namespace {
+uint8_t const PROTO_VARINT{0};
+uint8_t const PROTO_LENGTH_DELIMITED{2};
+uint8_t const PROTO_FOUR_BYTES{5};
+uint8_t const OD4_HEADER_BYTE0{0x0D};
+uint8_t const OD4_HEADER_BYTE1{0xA4};
+uint32_t const OD4_HEADER_SIZE{5};
+
+uint32_t toZigZag32(int32_t v) noexcept {
+  return static_cast<uint32_t>((v << 1) ^ (v >> 31));
+}
+}  // namespace
+
+ProtoWriter::ProtoWriter(uint8_t *buffer, uint32_t capacity) noexcept
+    : m_buffer{buffer}, m_capacity{capacity}, m_size{0}, m_overflow{false} {}
+
+void ProtoWriter::reset() noexcept {
+  m_size = 0;
+  m_overflow = false;
+}
+
+void ProtoWriter::writeFloat(uint32_t field, float value) noexcept {
+  writeVarInt((field << 3) | PROTO_FOUR_BYTES);
+  uint32_t raw{0};
+  std::memcpy(&raw, &value, sizeof(raw));
+  for (uint32_t i = 0; i < 4; i++) {
+    writeByte(static_cast<uint8_t>(raw >> (8 * i)));
+  }
+}
+
+void ProtoWriter::writeUint32(uint32_t field, uint32_t value) noexcept {
+  writeVarInt((field << 3) | PROTO_VARINT);
+  writeVarInt(value);
+}
+
+void ProtoWriter::writeInt32(uint32_t field, int32_t value) noexcept {
+  writeVarInt((field << 3) | PROTO_VARINT);
+  writeVarInt(toZigZag32(value));
+}
+
+void ProtoWriter::writeBytes(uint32_t field, uint8_t const *data,
+                             uint32_t length) noexcept {
+  writeVarInt((field << 3) | PROTO_LENGTH_DELIMITED);
+  writeVarInt(length);
+  for (uint32_t i = 0; i < length; i++) {
+    writeByte(data[i]);
+  }
+}
+
+void ProtoWriter::writeTimeStamp(
+    uint32_t field, cluon::data::TimeStamp const &timeStamp) noexcept {
+  uint8_t buffer[12];
+  ProtoWriter nested{buffer, sizeof(buffer)};
+  nested.writeInt32(1, timeStamp.seconds());
+  nested.writeInt32(2, timeStamp.microseconds());
+  writeBytes(field, nested.data(), nested.size());
+}
+
+uint8_t const *ProtoWriter::data() const noexcept { return m_buffer; }
+
+uint32_t ProtoWriter::size() const noexcept { return m_size; }
+
+bool ProtoWriter::overflow() const noexcept { return m_overflow; }
+
+void ProtoWriter::writeVarInt(uint64_t value) noexcept {
+  while (value > 0x7f) {
+    writeByte(static_cast<uint8_t>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  writeByte(static_cast<uint8_t>(value));
+}
+
+void ProtoWriter::writeByte(uint8_t value) noexcept {
+  if (m_size < m_capacity) {
+    m_buffer[m_size++] = value;
+  } else {
+    m_overflow = true;
+  }
+}
+
+EnvelopeEncoder::EnvelopeEncoder() noexcept
+    : m_payloadBuffer{},
+      m_containerBuffer{},
+      m_payload{m_payloadBuffer, MAX_PAYLOAD_SIZE},
+      m_dataType{0} {}
+
+ProtoWriter &EnvelopeEncoder::payload(int32_t dataType) noexcept {
+  m_dataType = dataType;
+  m_payload.reset();
+  return m_payload;
+}
+
+uint32_t EnvelopeEncoder::encode(cluon::data::TimeStamp const &sent,
+                                 cluon::data::TimeStamp const &sampleTimeStamp,
+                                 uint32_t senderStamp) noexcept {
+  if (m_payload.overflow()) {
+    return 0;
+  }
+  ProtoWriter envelope{m_containerBuffer + OD4_HEADER_SIZE,
+                       MAX_CONTAINER_SIZE - OD4_HEADER_SIZE};
+  envelope.writeInt32(1, m_dataType);
+  envelope.writeBytes(2, m_payload.data(), m_payload.size());
+  envelope.writeTimeStamp(3, sent);
+  envelope.writeTimeStamp(4, cluon::data::TimeStamp{});
+  envelope.writeTimeStamp(5, (0 == (sampleTimeStamp.seconds() +
+                                    sampleTimeStamp.microseconds()))
+                                 ? sent
+                                 : sampleTimeStamp);
+  envelope.writeUint32(6, senderStamp);
+  if (envelope.overflow()) {
+    return 0;
+  }
+
+  /* OD4 header: 0x0D 0xA4 followed by the envelope length as 24 bit little
+   * endian. */
+  uint32_t const length{envelope.size()};
+  m_containerBuffer[0] = OD4_HEADER_BYTE0;
+  m_containerBuffer[1] = OD4_HEADER_BYTE1;
+  m_containerBuffer[2] = static_cast<uint8_t>(length);
+  m_containerBuffer[3] = static_cast<uint8_t>(length >> 8);
+  m_containerBuffer[4] = static_cast<uint8_t>(length >> 16);
+  return OD4_HEADER_SIZE + length;
+}
+
+uint8_t const *EnvelopeEncoder::data() const noexcept {
+  return m_containerBuffer;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENVELOPE_ENCODER_HPP
+#define ENVELOPE_ENCODER_HPP
+
+#include <cstdint>
+
+#include "cluon-complete.hpp"
+
+/* Writes Protobuf fields the way cluon::ToProtoVisitor does (signed
+ * integers zigzag encoded, floats as little endian fixed32) into a fixed
+ * buffer. Writing past the end sets an overflow flag instead. */
+class ProtoWriter {
+ public:
+  ProtoWriter(uint8_t *buffer, uint32_t capacity) noexcept;
+
+ public:
+  void reset() noexcept;
+  void writeFloat(uint32_t field, float value) noexcept;
+  void writeUint32(uint32_t field, uint32_t value) noexcept;
+  void writeInt32(uint32_t field, int32_t value) noexcept;
+  void writeBytes(uint32_t field, uint8_t const *data,
+                  uint32_t length) noexcept;
+  void writeTimeStamp(uint32_t field,
+                      cluon::data::TimeStamp const &timeStamp) noexcept;
+  uint8_t const *data() const noexcept;
+  uint32_t size() const noexcept;
+  bool overflow() const noexcept;
+
+ private:
+  void writeVarInt(uint64_t value) noexcept;
+  void writeByte(uint8_t value) noexcept;
+
+ private:
+  uint8_t *m_buffer;
+  uint32_t m_capacity;
+  uint32_t m_size;
+  bool m_overflow;
+};
+
+/* Builds complete OD4 containers (header and cluon.data.Envelope) in
+ * preallocated storage, byte for byte what cluon::serializeEnvelope would
+ * produce, without any heap allocation. */
+class EnvelopeEncoder {
+ private:
+  EnvelopeEncoder(EnvelopeEncoder const &) = delete;
+  EnvelopeEncoder(EnvelopeEncoder &&) = delete;
+  EnvelopeEncoder &operator=(EnvelopeEncoder const &) = delete;
+  EnvelopeEncoder &operator=(EnvelopeEncoder &&) = delete;
+
+ public:
+  static uint32_t const MAX_PAYLOAD_SIZE{96};
+  static uint32_t const MAX_CONTAINER_SIZE{160};
+
+ public:
+  EnvelopeEncoder() noexcept;
+
+ public:
+  ProtoWriter &payload(int32_t dataType) noexcept;
+  uint32_t encode(cluon::data::TimeStamp const &sent,
+                  cluon::data::TimeStamp const &sampleTimeStamp,
+                  uint32_t senderStamp) noexcept;
+  uint8_t const *data() const noexcept;
+
+ private:
+  uint8_t m_payloadBuffer[MAX_PAYLOAD_SIZE];
+  uint8_t m_containerBuffer[MAX_CONTAINER_SIZE];
+  ProtoWriter m_payload;
+  int32_t m_dataType;
+};
+
+#endif
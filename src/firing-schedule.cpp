@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <numeric>
+
+#include "firing-schedule.hpp"
+
+namespace {
+uint32_t popcount(uint32_t mask) noexcept {
+  return static_cast<uint32_t>(__builtin_popcount(mask));
+}
+}  // namespace
+
+uint32_t const FiringSchedule::MAX_SENSORS;
+
+FiringSchedule::FiringSchedule(uint32_t sensorCount) noexcept
+    : m_neighbours(std::min(sensorCount, MAX_SENSORS), 0),
+      m_slotMasks(std::min(sensorCount, MAX_SENSORS), 1),
+      m_slotCount{1} {}
+
+bool FiringSchedule::addInterference(uint32_t a, uint32_t b) noexcept {
+  if (a == b || a >= m_neighbours.size() || b >= m_neighbours.size()) {
+    return false;
+  }
+  m_neighbours[a] |= 1U << b;
+  m_neighbours[b] |= 1U << a;
+  return true;
+}
+
+void FiringSchedule::build() noexcept {
+  uint32_t const count{static_cast<uint32_t>(m_neighbours.size())};
+  if (count == 0) {
+    m_slotCount = 1;
+    return;
+  }
+
+  /* Colouring the most constrained sensors first makes the backtracking
+   * search for the smallest number of slots fail early. With at most 32
+   * sensors on a bus, an exact search is cheap enough at startup. */
+  std::vector<uint32_t> order(count);
+  std::iota(order.begin(), order.end(), 0U);
+  std::stable_sort(order.begin(), order.end(),
+                   [this](uint32_t a, uint32_t b) {
+                     return popcount(m_neighbours[a]) >
+                            popcount(m_neighbours[b]);
+                   });
+  std::vector<uint32_t> colours(count, 0);
+  for (m_slotCount = 1; m_slotCount < count; m_slotCount++) {
+    std::fill(colours.begin(), colours.end(), m_slotCount);
+    if (colour(order.data(), 0, m_slotCount, colours)) {
+      break;
+    }
+  }
+  if (m_slotCount == count) {
+    std::iota(colours.begin(), colours.end(), 0U);
+  }
+
+  std::vector<uint32_t> members(m_slotCount, 0);
+  for (uint32_t i = 0; i < count; i++) {
+    m_slotMasks[i] = 1U << colours[i];
+    members[colours[i]] |= 1U << i;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t slot = 0; slot < m_slotCount; slot++) {
+      if ((members[slot] & m_neighbours[i]) == 0) {
+        m_slotMasks[i] |= 1U << slot;
+        members[slot] |= 1U << i;
+      }
+    }
+  }
+}
+
+uint32_t FiringSchedule::slotCount() const noexcept { return m_slotCount; }
+
+uint32_t FiringSchedule::slotMask(uint32_t sensor) const noexcept {
+  return m_slotMasks[sensor];
+}
+
+float FiringSchedule::rate(uint32_t sensor, float freq) const noexcept {
+  return freq * static_cast<float>(popcount(m_slotMasks[sensor])) /
+         static_cast<float>(m_slotCount);
+}
+
+bool FiringSchedule::colour(uint32_t const *order, uint32_t position,
+                            uint32_t slots,
+                            std::vector<uint32_t> &colours) const noexcept {
+  if (position == colours.size()) {
+    return true;
+  }
+  uint32_t const sensor{order[position]};
+  /* A new slot is only opened after all used ones, which avoids trying
+   * permutations of the same colouring. */
+  uint32_t used{0};
+  for (uint32_t i = 0; i < position; i++) {
+    used = std::max(used, colours[order[i]] + 1);
+  }
+  for (uint32_t slot = 0; slot < std::min(used + 1, slots); slot++) {
+    bool free{true};
+    for (uint32_t i = 0; i < colours.size() && free; i++) {
+      free = !((m_neighbours[sensor] >> i) & 1U) || colours[i] != slot;
+    }
+    if (free) {
+      colours[sensor] = slot;
+      if (colour(order, position + 1, slots, colours)) {
+        return true;
+      }
+      colours[sensor] = slots;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIRING_SCHEDULE_HPP
+#define FIRING_SCHEDULE_HPP
+
+#include <cstdint>
+#include <vector>
+
+/* Splits the sensors on one bus into time slots so that sensors which hear
+ * each other's pings never range at the same time. The interference graph
+ * is coloured with as few slots as possible, since every slot takes one
+ * cycle. Each sensor then also joins every other slot in which none of its
+ * neighbours fire, which raises the aggregate sample rate further. Slots
+ * are bit masks, so at most 32 sensors are supported. */
+class FiringSchedule {
+ private:
+  FiringSchedule(FiringSchedule const &) = delete;
+  FiringSchedule(FiringSchedule &&) = delete;
+  FiringSchedule &operator=(FiringSchedule const &) = delete;
+  FiringSchedule &operator=(FiringSchedule &&) = delete;
+
+ public:
+  static uint32_t const MAX_SENSORS{32};
+
+ public:
+  explicit FiringSchedule(uint32_t sensorCount) noexcept;
+
+ public:
+  bool addInterference(uint32_t a, uint32_t b) noexcept;
+  void build() noexcept;
+  uint32_t slotCount() const noexcept;
+  uint32_t slotMask(uint32_t sensor) const noexcept;
+  float rate(uint32_t sensor, float freq) const noexcept;
+
+ private:
+  bool colour(uint32_t const *order, uint32_t position, uint32_t slots,
+              std::vector<uint32_t> &colours) const noexcept;
+
+ private:
+  std::vector<uint32_t> m_neighbours;
+  std::vector<uint32_t> m_slotMasks;
+  uint32_t m_slotCount;
+};
+
+#endif
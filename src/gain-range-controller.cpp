@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "gain-range-controller.hpp"
+
+namespace {
+float const RANGE_STEP{0.043f}; /* m per range register step */
+float const MIN_WINDOW{1.0f};   /* m */
+/* The window is set to the farthest echo times RANGE_FACTOR plus
+ * RANGE_MARGIN, and opened fully when an echo is beyond EDGE of it. */
+float const RANGE_FACTOR{1.25f};
+float const RANGE_MARGIN{0.3f};
+float const EDGE{0.8f};
+/* Closest echoes of consecutive pings further apart than JUMP_DISTANCE
+ * count as a jump. */
+float const JUMP_DISTANCE{0.3f};
+float const CLUTTER_JUMPS{0.25f}; /* Share of pings that lowers the gain */
+float const STABLE_JUMPS{0.05f};  /* Share of pings that allows raising it */
+float const MIN_DETECTIONS{0.5f}; /* Share of pings below which it is raised */
+uint8_t const GAIN_STEP{2};
+}  // namespace
+
+uint32_t const GainRangeController::PROBE_INTERVAL;
+
+GainRangeController::GainRangeController(uint8_t maxRange, uint8_t maxGain,
+                                         uint32_t window) noexcept
+    : m_maxRange{maxRange},
+      m_maxGain{maxGain},
+      m_window{(window > 0) ? window : 1},
+      m_range{maxRange},
+      m_gain{maxGain},
+      m_windows{0},
+      m_pings{0},
+      m_detections{0},
+      m_jumps{0},
+      m_farthest{0.0f},
+      m_previous{-1.0f} {}
+
+uint8_t GainRangeController::range() const noexcept { return m_range; }
+
+uint8_t GainRangeController::gain() const noexcept { return m_gain; }
+
+void GainRangeController::setMaxRange(uint8_t maxRange) noexcept {
+  m_maxRange = maxRange;
+  m_range = std::min(m_range, maxRange);
+}
+
+void GainRangeController::setMaxGain(uint8_t maxGain) noexcept {
+  m_maxGain = maxGain;
+  m_gain = std::min(m_gain, maxGain);
+}
+
+float GainRangeController::rangeWindow(uint8_t range) noexcept {
+  return (static_cast<float>(range) + 1.0f) * RANGE_STEP;
+}
+
+uint8_t GainRangeController::rangeRegister(float window) noexcept {
+  float const steps{std::ceil(window / RANGE_STEP) - 1.0f};
+  return static_cast<uint8_t>(std::min(std::max(steps, 0.0f), 255.0f));
+}
+
+void GainRangeController::observe(Srf08Echoes const &echoes) noexcept {
+  m_pings++;
+  if (echoes.count > 0) {
+    float const closest{echoes.distances[0]};
+    m_detections++;
+    m_farthest = std::max(m_farthest, echoes.distances[echoes.count - 1]);
+    if (m_previous >= 0.0f && std::fabs(closest - m_previous) > JUMP_DISTANCE) {
+      m_jumps++;
+    }
+    m_previous = closest;
+  } else {
+    m_previous = -1.0f;
+  }
+  if (m_pings >= m_window) {
+    adjust();
+  }
+}
+
+void GainRangeController::adjust() noexcept {
+  float const pings{static_cast<float>(m_pings)};
+  float const jumps{static_cast<float>(m_jumps) / pings};
+  float const detections{static_cast<float>(m_detections) / pings};
+  if (jumps > CLUTTER_JUMPS) {
+    m_gain = static_cast<uint8_t>(std::max(m_gain - GAIN_STEP, 0));
+  } else if (detections < MIN_DETECTIONS && jumps <= STABLE_JUMPS) {
+    m_gain = static_cast<uint8_t>(
+        std::min(m_gain + GAIN_STEP, static_cast<int32_t>(m_maxGain)));
+  }
+
+  m_windows++;
+  if (m_windows % PROBE_INTERVAL == 0 ||
+      m_farthest > EDGE * rangeWindow(m_range)) {
+    m_range = m_maxRange;
+  } else {
+    float const window{
+        std::max(m_farthest * RANGE_FACTOR + RANGE_MARGIN, MIN_WINDOW)};
+    m_range = std::min(rangeRegister(window), m_maxRange);
+  }
+
+  m_pings = 0;
+  m_detections = 0;
+  m_jumps = 0;
+  m_farthest = 0.0f;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GAIN_RANGE_CONTROLLER_HPP
+#define GAIN_RANGE_CONTROLLER_HPP
+
+#include <cstdint>
+
+#include "srf08.hpp"
+
+/* Closed-loop control of the gain and range registers of one SRF08, from
+ * the echoes it returns over a window of pings. The range window is cut
+ * down to just beyond the farthest echo, which shortens ranging, and is
+ * opened fully again when an echo comes close to its end and on every
+ * PROBE_INTERVAL-th window, so that objects farther away are found again.
+ * The gain is lowered while the closest echo jumps around, a sign of
+ * clutter or false early echoes, and raised again while the sensor misses
+ * most pings in a stable scene. Neither ever exceeds its limit, and both
+ * limits may be lowered and raised again at runtime. */
+class GainRangeController {
+ private:
+  GainRangeController(GainRangeController const &) = delete;
+  GainRangeController(GainRangeController &&) = delete;
+  GainRangeController &operator=(GainRangeController const &) = delete;
+  GainRangeController &operator=(GainRangeController &&) = delete;
+
+ public:
+  static uint32_t const PROBE_INTERVAL{10};
+
+ public:
+  GainRangeController(uint8_t maxRange, uint8_t maxGain,
+                      uint32_t window) noexcept;
+
+ public:
+  uint8_t range() const noexcept;
+  uint8_t gain() const noexcept;
+  void setMaxRange(uint8_t maxRange) noexcept;
+  void setMaxGain(uint8_t maxGain) noexcept;
+  void observe(Srf08Echoes const &echoes) noexcept;
+
+  static float rangeWindow(uint8_t range) noexcept;
+  static uint8_t rangeRegister(float window) noexcept;
+
+ private:
+  void adjust() noexcept;
+
+ private:
+  uint8_t m_maxRange;
+  uint8_t m_maxGain;
+  uint32_t m_window;
+  uint8_t m_range;
+  uint8_t m_gain;
+  uint32_t m_windows;
+  uint32_t m_pings;
+  uint32_t m_detections;
+  uint32_t m_jumps;
+  float m_farthest;
+  float m_previous; /* Closest echo of the last ping, negative if none */
+};
+
+#endif
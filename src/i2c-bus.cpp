@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "i2c-bus.hpp"
+
+I2cBus::I2cBus(std::string const &devNode) noexcept : m_devNode{devNode} {}
+
+I2cBus::~I2cBus() {}
+
+std::string const &I2cBus::devNode() const noexcept { return m_devNode; }
+
+bool I2cBus::readRegisters(uint8_t address, uint8_t reg, uint8_t *data,
+                           uint16_t length) noexcept {
+  I2cRegisterRead const request{address, reg, data, length};
+  return readRegisters(&request, 1);
+}
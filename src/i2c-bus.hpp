@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef I2C_BUS_HPP
+#define I2C_BUS_HPP
+
+#include <cstdint>
+#include <string>
+
+/* One register read: the register pointer is written and length bytes are
+ * read back into data using a repeated start. */
+struct I2cRegisterRead {
+  uint8_t address;
+  uint8_t reg;
+  uint8_t *data;
+  uint16_t length;
+};
+
+/* An I2C bus with several devices on it. Implemented by LinuxI2cBus for
+ * /dev/i2c-N nodes and by SimulatedI2cBus for tests and benchmarks. A
+ * transfer to a device that does not acknowledge returns false. */
+class I2cBus {
+ private:
+  I2cBus(I2cBus const &) = delete;
+  I2cBus(I2cBus &&) = delete;
+  I2cBus &operator=(I2cBus const &) = delete;
+  I2cBus &operator=(I2cBus &&) = delete;
+
+ protected:
+  explicit I2cBus(std::string const &devNode) noexcept;
+
+ public:
+  virtual ~I2cBus();
+
+ public:
+  std::string const &devNode() const noexcept;
+  bool readRegisters(uint8_t address, uint8_t reg, uint8_t *data,
+                     uint16_t length) noexcept;
+
+  virtual bool isOpen() const noexcept = 0;
+  virtual bool write(uint8_t address, uint8_t const *data,
+                     uint32_t length) noexcept = 0;
+  virtual bool read(uint8_t address, uint8_t *data,
+                    uint32_t length) noexcept = 0;
+  virtual bool readRegisters(I2cRegisterRead const *reads,
+                             uint32_t count) noexcept = 0;
+
+ private:
+  std::string m_devNode;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "linux-i2c-bus.hpp"
+
+LinuxI2cBus::LinuxI2cBus(std::string const &devNode) noexcept
+    : I2cBus{devNode},
+      m_deviceFile{-1},
+      m_currentAddress{-1},
+      m_hasCombinedTransfers{false} {
+  m_deviceFile = open(devNode.c_str(), O_RDWR);
+  unsigned long funcs{0};
+  if (m_deviceFile >= 0 && ioctl(m_deviceFile, I2C_FUNCS, &funcs) >= 0) {
+    m_hasCombinedTransfers = (funcs & I2C_FUNC_I2C) != 0;
+  }
+}
+
+LinuxI2cBus::~LinuxI2cBus() {
+  if (m_deviceFile >= 0) {
+    close(m_deviceFile);
+  }
+}
+
+bool LinuxI2cBus::isOpen() const noexcept { return m_deviceFile >= 0; }
+
+bool LinuxI2cBus::write(uint8_t address, uint8_t const *data,
+                        uint32_t length) noexcept {
+  if (!selectDevice(address)) {
+    return false;
+  }
+  ssize_t const res = ::write(m_deviceFile, data, length);
+  return res == static_cast<ssize_t>(length);
+}
+
+bool LinuxI2cBus::read(uint8_t address, uint8_t *data,
+                       uint32_t length) noexcept {
+  if (!selectDevice(address)) {
+    return false;
+  }
+  ssize_t const res = ::read(m_deviceFile, data, length);
+  return res == static_cast<ssize_t>(length);
+}
+
+bool LinuxI2cBus::readRegisters(I2cRegisterRead const *reads,
+                                uint32_t count) noexcept {
+  if (!m_hasCombinedTransfers) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (!write(reads[i].address, &reads[i].reg, 1) ||
+          !read(reads[i].address, reads[i].data, reads[i].length)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /* Every read is a register pointer write followed by a repeated start
+   * read, and as many reads as the kernel accepts share one ioctl. */
+  uint32_t const MAX_READS_PER_IOCTL{I2C_RDWR_IOCTL_MAX_MSGS / 2};
+  struct i2c_msg messages[2 * MAX_READS_PER_IOCTL];
+  for (uint32_t first = 0; first < count; first += MAX_READS_PER_IOCTL) {
+    uint32_t const n{(count - first < MAX_READS_PER_IOCTL)
+                         ? count - first
+                         : MAX_READS_PER_IOCTL};
+    for (uint32_t i = 0; i < n; i++) {
+      I2cRegisterRead const &r = reads[first + i];
+      messages[2 * i].addr = r.address;
+      messages[2 * i].flags = 0;
+      messages[2 * i].len = 1;
+      messages[2 * i].buf = const_cast<uint8_t *>(&r.reg);
+      messages[2 * i + 1].addr = r.address;
+      messages[2 * i + 1].flags = I2C_M_RD;
+      messages[2 * i + 1].len = r.length;
+      messages[2 * i + 1].buf = r.data;
+    }
+    struct i2c_rdwr_ioctl_data transfer;
+    transfer.msgs = messages;
+    transfer.nmsgs = 2 * n;
+    if (ioctl(m_deviceFile, I2C_RDWR, &transfer) != static_cast<int>(2 * n)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LinuxI2cBus::selectDevice(uint8_t address) noexcept {
+  if (m_currentAddress == address) {
+    return true;
+  }
+  if (ioctl(m_deviceFile, I2C_SLAVE, address) < 0) {
+    m_currentAddress = -1;
+    return false;
+  }
+  m_currentAddress = address;
+  return true;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINUX_I2C_BUS_HPP
+#define LINUX_I2C_BUS_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "i2c-bus.hpp"
+
+/* Owns the file descriptor of one /dev/i2c-N node so that several devices on
+ * the same bus can be driven from one process. The slave address is only
+ * re-bound when the next transfer targets another device. Register reads use
+ * combined I2C_RDWR transactions when the adapter supports them. */
+class LinuxI2cBus : public I2cBus {
+ private:
+  LinuxI2cBus(LinuxI2cBus const &) = delete;
+  LinuxI2cBus(LinuxI2cBus &&) = delete;
+  LinuxI2cBus &operator=(LinuxI2cBus const &) = delete;
+  LinuxI2cBus &operator=(LinuxI2cBus &&) = delete;
+
+ public:
+  explicit LinuxI2cBus(std::string const &devNode) noexcept;
+  ~LinuxI2cBus() override;
+
+ public:
+  using I2cBus::readRegisters;
+  bool isOpen() const noexcept override;
+  bool write(uint8_t address, uint8_t const *data,
+             uint32_t length) noexcept override;
+  bool read(uint8_t address, uint8_t *data, uint32_t length) noexcept override;
+  bool readRegisters(I2cRegisterRead const *reads,
+                     uint32_t count) noexcept override;
+
+ private:
+  bool selectDevice(uint8_t address) noexcept;
+
+ private:
+  int32_t m_deviceFile;
+  int32_t m_currentAddress;
+  bool m_hasCombinedTransfers;
+};
+
+#endif
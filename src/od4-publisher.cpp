@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+
+#include "opendlv-device-ultrasonic-srf08-messages.hpp"
+#include "opendlv-standard-message-set.hpp"
+
+#include "gain-range-controller.hpp"
+#include "od4-publisher.hpp"
+
+namespace {
+uint16_t const OD4_PORT{12175};
+}  // namespace
+
+uint32_t const DatagramBatch::MAX_DATAGRAMS;
+
+DatagramBatch::DatagramBatch() noexcept
+    : m_buffers{}, m_iovecs{}, m_messages{}, m_size{0} {
+  std::memset(m_messages, 0, sizeof(m_messages));
+  for (uint32_t i = 0; i < MAX_DATAGRAMS; i++) {
+    m_iovecs[i].iov_base = m_buffers[i];
+    m_iovecs[i].iov_len = 0;
+    m_messages[i].msg_hdr.msg_iov = &m_iovecs[i];
+    m_messages[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+bool DatagramBatch::add(uint8_t const *data, uint32_t length) noexcept {
+  if (full() || length > EnvelopeEncoder::MAX_CONTAINER_SIZE) {
+    return false;
+  }
+  std::memcpy(m_buffers[m_size], data, length);
+  m_iovecs[m_size].iov_len = length;
+  m_size++;
+  return true;
+}
+
+void DatagramBatch::clear() noexcept { m_size = 0; }
+
+bool DatagramBatch::full() const noexcept { return m_size == MAX_DATAGRAMS; }
+
+uint32_t DatagramBatch::size() const noexcept { return m_size; }
+
+uint8_t const *DatagramBatch::data(uint32_t index) const noexcept {
+  return m_buffers[index];
+}
+
+uint32_t DatagramBatch::length(uint32_t index) const noexcept {
+  return static_cast<uint32_t>(m_iovecs[index].iov_len);
+}
+
+struct mmsghdr *DatagramBatch::messages(
+    struct sockaddr_in *address) noexcept {
+  for (uint32_t i = 0; i < m_size; i++) {
+    m_messages[i].msg_hdr.msg_name = address;
+    m_messages[i].msg_hdr.msg_namelen = sizeof(*address);
+  }
+  return m_messages;
+}
+
+Od4Publisher::Od4Publisher(uint16_t cid, bool batch) noexcept
+    : m_socket{-1},
+      m_sendToAddress{},
+      m_batch{batch ? new DatagramBatch : nullptr},
+      m_sends{0},
+      m_sendCalls{0},
+      m_sendNanoseconds{0},
+      m_maxSendNanoseconds{0} {
+  std::memset(&m_sendToAddress, 0, sizeof(m_sendToAddress));
+  m_sendToAddress.sin_family = AF_INET;
+  m_sendToAddress.sin_port = htons(OD4_PORT);
+  m_sendToAddress.sin_addr.s_addr =
+      htonl((225U << 24) | static_cast<uint32_t>(cid & 0xFF));
+  m_socket = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+}
+
+Od4Publisher::~Od4Publisher() {
+  flush();
+  if (m_socket >= 0) {
+    ::close(m_socket);
+  }
+}
+
+bool Od4Publisher::isOpen() const noexcept { return m_socket >= 0; }
+
+bool Od4Publisher::sendDistance(EnvelopeEncoder &encoder, float distance,
+                                cluon::data::TimeStamp const &sampleTimeStamp,
+                                uint32_t senderStamp) noexcept {
+  encoder.payload(opendlv::proxy::DistanceReading::ID())
+      .writeFloat(1, distance);
+  uint32_t const length{
+      encoder.encode(cluon::time::now(), sampleTimeStamp, senderStamp)};
+  return length > 0 && send(encoder.data(), length);
+}
+
+bool Od4Publisher::sendLongWindowDistance(
+    EnvelopeEncoder &encoder, float distance, uint8_t range,
+    cluon::data::TimeStamp const &sampleTimeStamp,
+    uint32_t senderStamp) noexcept {
+  ProtoWriter &payload = encoder.payload(
+      opendlv::device::ultrasonic::LongWindowDistanceReading::ID());
+  payload.writeFloat(1, distance);
+  payload.writeFloat(2, GainRangeController::rangeWindow(range));
+  uint32_t const length{
+      encoder.encode(cluon::time::now(), sampleTimeStamp, senderStamp)};
+  return length > 0 && send(encoder.data(), length);
+}
+
+bool Od4Publisher::sendFilteredDistance(
+    EnvelopeEncoder &encoder, float distance,
+    cluon::data::TimeStamp const &sampleTimeStamp,
+    uint32_t senderStamp) noexcept {
+  encoder
+      .payload(opendlv::device::ultrasonic::FilteredDistanceReading::ID())
+      .writeFloat(1, distance);
+  uint32_t const length{
+      encoder.encode(cluon::time::now(), sampleTimeStamp, senderStamp)};
+  return length > 0 && send(encoder.data(), length);
+}
+
+uint32_t Od4Publisher::encodeEchoes(
+    EnvelopeEncoder &encoder, Srf08Echoes const &echoes,
+    cluon::data::TimeStamp const &sampleTimeStamp,
+    uint32_t senderStamp) noexcept {
+  uint8_t distances[4 * srf08::MAX_ECHOES];
+  for (uint32_t i = 0; i < echoes.count; i++) {
+    uint32_t raw{0};
+    std::memcpy(&raw, &echoes.distances[i], sizeof(raw));
+    for (uint32_t j = 0; j < 4; j++) {
+      distances[4 * i + j] = static_cast<uint8_t>(raw >> (8 * j));
+    }
+  }
+  ProtoWriter &payload =
+      encoder.payload(opendlv::device::ultrasonic::EchoReading::ID());
+  payload.writeUint32(1, echoes.count);
+  payload.writeBytes(2, distances, 4U * echoes.count);
+  payload.writeFloat(3, GainRangeController::rangeWindow(echoes.range));
+  return encoder.encode(cluon::time::now(), sampleTimeStamp, senderStamp);
+}
+
+bool Od4Publisher::sendEchoes(EnvelopeEncoder &encoder,
+                              Srf08Echoes const &echoes,
+                              cluon::data::TimeStamp const &sampleTimeStamp,
+                              uint32_t senderStamp) noexcept {
+  uint32_t const length{
+      encodeEchoes(encoder, echoes, sampleTimeStamp, senderStamp)};
+  return length > 0 && send(encoder.data(), length);
+}
+
+bool Od4Publisher::sendLight(EnvelopeEncoder &encoder, float level,
+                             cluon::data::TimeStamp const &sampleTimeStamp,
+                             uint32_t senderStamp) noexcept {
+  encoder.payload(opendlv::device::ultrasonic::LightReading::ID())
+      .writeFloat(1, level);
+  uint32_t const length{
+      encoder.encode(cluon::time::now(), sampleTimeStamp, senderStamp)};
+  return length > 0 && send(encoder.data(), length);
+}
+
+bool Od4Publisher::sendTrack(EnvelopeEncoder &encoder, RangeTrack const &track,
+                             cluon::data::TimeStamp const &sampleTimeStamp,
+                             uint32_t senderStamp) noexcept {
+  ProtoWriter &payload =
+      encoder.payload(opendlv::device::ultrasonic::RangeTrack::ID());
+  payload.writeFloat(1, track.distance);
+  payload.writeFloat(2, track.closingSpeed);
+  payload.writeFloat(3, track.distanceVariance);
+  payload.writeFloat(4, track.closingSpeedVariance);
+  payload.writeFloat(5, track.covariance);
+  uint32_t const length{
+      encoder.encode(cluon::time::now(), sampleTimeStamp, senderStamp)};
+  return length > 0 && send(encoder.data(), length);
+}
+
+bool Od4Publisher::send(uint8_t const *data, uint32_t length) noexcept {
+  if (m_batch) {
+    if (m_batch->full() && !flush()) {
+      return false;
+    }
+    return m_batch->add(data, length);
+  }
+  auto const start{std::chrono::steady_clock::now()};
+  ssize_t const sent{::sendto(
+      m_socket, data, length, 0,
+      reinterpret_cast<struct sockaddr const *>(&m_sendToAddress),
+      sizeof(m_sendToAddress))};
+  countSendCall(1, static_cast<uint64_t>(
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count()));
+  return sent == static_cast<ssize_t>(length);
+}
+
+bool Od4Publisher::flush() noexcept {
+  /* sendmmsg may stop early, so whatever it left is sent with another
+   * call. The batch is emptied even when sending fails. */
+  if (!m_batch || m_batch->size() == 0) {
+    return true;
+  }
+  struct mmsghdr *messages{m_batch->messages(&m_sendToAddress)};
+  uint32_t const count{m_batch->size()};
+  uint32_t sent{0};
+  while (sent < count) {
+    auto const start{std::chrono::steady_clock::now()};
+    int32_t const result{::sendmmsg(m_socket, messages + sent, count - sent,
+                                    0)};
+    countSendCall(
+        (result > 0) ? static_cast<uint64_t>(result) : 0,
+        static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count()));
+    if (result <= 0) {
+      break;
+    }
+    sent += static_cast<uint32_t>(result);
+  }
+  m_batch->clear();
+  return sent == count;
+}
+
+void Od4Publisher::countSendCall(uint64_t datagrams,
+                                 uint64_t duration) noexcept {
+  m_sends.fetch_add(datagrams, std::memory_order_relaxed);
+  m_sendCalls.fetch_add(1, std::memory_order_relaxed);
+  m_sendNanoseconds.fetch_add(duration, std::memory_order_relaxed);
+  uint64_t max{m_maxSendNanoseconds.load(std::memory_order_relaxed)};
+  while (duration > max && !m_maxSendNanoseconds.compare_exchange_weak(
+                               max, duration, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t Od4Publisher::sends() const noexcept { return m_sends.load(); }
+
+uint64_t Od4Publisher::sendCalls() const noexcept {
+  return m_sendCalls.load();
+}
+
+uint64_t Od4Publisher::sendNanoseconds() const noexcept {
+  return m_sendNanoseconds.load();
+}
+
+uint64_t Od4Publisher::maxSendNanoseconds() const noexcept {
+  return m_maxSendNanoseconds.load();
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OD4_PUBLISHER_HPP
+#define OD4_PUBLISHER_HPP
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "cluon-complete.hpp"
+#include "envelope-encoder.hpp"
+#include "range-tracker.hpp"
+#include "srf08.hpp"
+
+/* Preallocated storage for up to MAX_DATAGRAMS OD4 containers, one per
+ * datagram, laid out for a single sendmmsg call. */
+class DatagramBatch {
+ private:
+  DatagramBatch(DatagramBatch const &) = delete;
+  DatagramBatch(DatagramBatch &&) = delete;
+  DatagramBatch &operator=(DatagramBatch const &) = delete;
+  DatagramBatch &operator=(DatagramBatch &&) = delete;
+
+ public:
+  static uint32_t const MAX_DATAGRAMS{64};
+
+ public:
+  DatagramBatch() noexcept;
+
+ public:
+  bool add(uint8_t const *data, uint32_t length) noexcept;
+  void clear() noexcept;
+  bool full() const noexcept;
+  uint32_t size() const noexcept;
+  uint8_t const *data(uint32_t index) const noexcept;
+  uint32_t length(uint32_t index) const noexcept;
+  struct mmsghdr *messages(struct sockaddr_in *address) noexcept;
+
+ private:
+  uint8_t m_buffers[MAX_DATAGRAMS][EnvelopeEncoder::MAX_CONTAINER_SIZE];
+  struct iovec m_iovecs[MAX_DATAGRAMS];
+  struct mmsghdr m_messages[MAX_DATAGRAMS];
+  uint32_t m_size;
+};
+
+/* Sends OD4 containers to the multicast group of an OD4 session from a
+ * preallocated encoder, so that publishing does not allocate. Messages sent
+ * this way are received like those from cluon::OD4Session::send.
+ *
+ * One publisher can be shared by several acquisition threads. Each thread
+ * encodes into its own encoder, and datagrams sent on one UDP socket from
+ * several threads need no lock, unlike the sender mutex of OD4Session. The
+ * time spent in sendto is measured, which shows any contention left on the
+ * socket inside the kernel.
+ *
+ * In batch mode, containers are collected instead and sent by flush() with
+ * one sendmmsg call. Every container still travels in a datagram of its
+ * own, as OD4Session only reads the first envelope of each datagram. A
+ * batching publisher belongs to a single thread, and flushes by itself
+ * when its batch is full. */
+class Od4Publisher {
+ private:
+  Od4Publisher(Od4Publisher const &) = delete;
+  Od4Publisher(Od4Publisher &&) = delete;
+  Od4Publisher &operator=(Od4Publisher const &) = delete;
+  Od4Publisher &operator=(Od4Publisher &&) = delete;
+
+ public:
+  Od4Publisher(uint16_t cid, bool batch) noexcept;
+  ~Od4Publisher();
+
+ public:
+  bool isOpen() const noexcept;
+  bool sendDistance(EnvelopeEncoder &encoder, float distance,
+                    cluon::data::TimeStamp const &sampleTimeStamp,
+                    uint32_t senderStamp) noexcept;
+  bool sendLongWindowDistance(EnvelopeEncoder &encoder, float distance,
+                              uint8_t range,
+                              cluon::data::TimeStamp const &sampleTimeStamp,
+                              uint32_t senderStamp) noexcept;
+  bool sendFilteredDistance(EnvelopeEncoder &encoder, float distance,
+                            cluon::data::TimeStamp const &sampleTimeStamp,
+                            uint32_t senderStamp) noexcept;
+  static uint32_t encodeEchoes(EnvelopeEncoder &encoder,
+                               Srf08Echoes const &echoes,
+                               cluon::data::TimeStamp const &sampleTimeStamp,
+                               uint32_t senderStamp) noexcept;
+  bool sendEchoes(EnvelopeEncoder &encoder, Srf08Echoes const &echoes,
+                  cluon::data::TimeStamp const &sampleTimeStamp,
+                  uint32_t senderStamp) noexcept;
+  bool sendLight(EnvelopeEncoder &encoder, float level,
+                 cluon::data::TimeStamp const &sampleTimeStamp,
+                 uint32_t senderStamp) noexcept;
+  bool sendTrack(EnvelopeEncoder &encoder, RangeTrack const &track,
+                 cluon::data::TimeStamp const &sampleTimeStamp,
+                 uint32_t senderStamp) noexcept;
+  bool send(uint8_t const *data, uint32_t length) noexcept;
+  bool flush() noexcept;
+  uint64_t sends() const noexcept;
+  uint64_t sendCalls() const noexcept;
+  uint64_t sendNanoseconds() const noexcept;
+  uint64_t maxSendNanoseconds() const noexcept;
+
+ private:
+  void countSendCall(uint64_t datagrams, uint64_t duration) noexcept;
+
+ private:
+  int32_t m_socket;
+  struct sockaddr_in m_sendToAddress;
+  std::unique_ptr<DatagramBatch> m_batch; /* nullptr unless batching */
+  std::atomic<uint64_t> m_sends;
+  std::atomic<uint64_t> m_sendCalls;
+  std::atomic<uint64_t> m_sendNanoseconds;
+  std::atomic<uint64_t> m_maxSendNanoseconds;
+};
+
+#endif
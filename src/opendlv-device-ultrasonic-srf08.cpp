@@ -15,19 +15,52 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <ncurses.h>
+#include <algorithm>
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <sstream>
+#include <string>
 #include <vector>
 
-#include <fcntl.h>
-#include <linux/i2c-dev.h>
-#include <sys/ioctl.h>
-#include <unistd.h>
-
 #include "cluon-complete.hpp"
+#include "opendlv-device-ultrasonic-srf08-messages.hpp"
 #include "opendlv-standard-message-set.hpp"
 
+#include "bus-acquisition.hpp"
+#include "deadline-scheduler.hpp"
+#include "display.hpp"
+#include "firing-schedule.hpp"
+#include "gain-range-controller.hpp"
+#include "linux-i2c-bus.hpp"
+#include "od4-publisher.hpp"
+#include "publisher-thread.hpp"
+#include "range-tracker.hpp"
+#include "realtime.hpp"
+#include "rolling-filter.hpp"
+#include "speed-curve.hpp"
+#include "srf08-array.hpp"
+#include "srf08.hpp"
+
+/* Splits a comma-separated list. Unlike stringtoolbox::split, a single
+ * value without any delimiter is returned as a list of one. */
+static std::vector<std::string> splitList(std::string const &arg) {
+  std::vector<std::string> tokens{stringtoolbox::split(arg, ',')};
+  if (tokens.empty() && !arg.empty()) {
+    tokens.push_back(arg);
+  }
+  return tokens;
+}
+
+/* Parses a comma-separated list of decimal integers, e.g. "112,113,114". */
+static std::vector<uint32_t> parseList(std::string const &arg) {
+  std::vector<uint32_t> values;
+  for (auto const &token : splitList(arg)) {
+    values.push_back(static_cast<uint32_t>(std::stoi(token)));
+  }
+  return values;
+}
+
 int32_t main(int32_t argc, char **argv) {
   int32_t retCode{0};
   auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
@@ -38,168 +71,825 @@ int32_t main(int32_t argc, char **argv) {
       0 == commandlineArguments.count("range") ||
       0 == commandlineArguments.count("gain")) {
     std::cerr << argv[0]
-              << " interfaces to an SRF02 ultrasonic distance sensor using i2c."
+              << " interfaces to one or more SRF08 ultrasonic distance sensors "
+                 "on one or more i2c buses."
               << std::endl;
     std::cerr
         << "Usage:   " << argv[0]
-        << " --dev=<I2C device node> --bus-address=<Sensor address on the i2c "
+        << " --dev=<I2C device node(s)> [--bus=<Index of the --dev of each "
+           "sensor>] --bus-address=<Sensor address on the i2c "
            "bus, in decimal format> --freq=<Parse frequency> "
            "--cid=<OpenDaVINCI session> [--id=<ID if more than one sensor>]  "
-           "--range=[decimal integer] --gain=[decimal integer][--verbose]"
+           "--range=[decimal integer] --gain=[decimal integer][--verbose] "
+           "[--poll-interval=<Ranging-complete poll interval in ms>] "
+           "[--poll-timeout=<Give up polling after ms, default 70>] "
+           "[--echoes=<Number of echoes to read, 1 to 17, default 1>] "
+           "[--all-echoes] [--display-freq=<Refresh rate of --verbose=2, "
+           "default 10>] "
+           "[--pipelined] [--overrun=<skip|catch-up, default skip>] "
+           "[--interference=<id-id pairs of sensors that hear each other>] "
+           "[--filter=<median|hampel> [--filter-window=<Samples, default 5>] "
+           "[--hampel-threshold=<Deviations, default 3>]] "
+           "[--publish=<raw|filtered|both>] "
+           "[--track [--track-range-noise=<m, default 0.03>] "
+           "[--track-acceleration-noise=<m/s^2, default 3>] "
+           "[--track-max-coast=<s, default 1>]] "
+           "[--adaptive [--adaptive-window=<Pings per step, default 20>]] "
+           "[--speed-curve=<speed:rate:window,... in m/s, Hz and m> "
+           "[--speed-id=<Sender stamp of the GroundSpeedReading, default 0>] "
+           "[--forward=<ids of the forward-facing sensors>]] "
+           "[--long-range=<Range register of the long window> "
+           "[--long-every=<Rounds per long-window round, default 10>]] "
+           "[--config-id=<Sender stamp of the ConfigurationRequest to "
+           "follow>] "
+           "[--batch] [--broadcast] [--light] [--microseconds [--temperature="
+           "<Air temperature in degrees Celsius, default 20>] "
+           "[--temperature-id=<Sender stamp of an "
+           "opendlv.proxy.TemperatureReading to follow>]] "
+           "[--realtime [--rt-priority=<SCHED_FIFO priority, default 50>] "
+           "[--rt-cpu=<CPU to pin the acquisition thread(s) to>]]"
         << std::endl;
+    std::cerr << "         Several sensors on the same bus are given as "
+                 "comma-separated lists to --bus-address, --id, --range, "
+                 "--gain and --echoes. A single --range, --gain or --echoes "
+                 "value applies to all sensors, and --id defaults to the "
+                 "position in the list."
+              << std::endl;
+    std::cerr << "         --all-echoes also publishes every valid echo of "
+                 "a ping in one opendlv.device.ultrasonic.EchoReading, and "
+                 "reads 17 echoes unless --echoes is given."
+              << std::endl;
+    std::cerr << "         Several buses are given as a comma-separated "
+                 "list to --dev, and --bus then lists the position in that "
+                 "list for each sensor. Every bus is run by its own thread, "
+                 "and --rt-cpu may list one CPU per bus."
+              << std::endl;
     std::cerr << "Example: " << argv[0]
               << " --dev=/dev/i2c-0 --bus-address=112 --freq=10 --cid=111 "
                  "--range=100 --gain=1"
               << std::endl;
+    std::cerr << "         " << argv[0]
+              << " --dev=/dev/i2c-0 --bus-address=112,113,114 --id=0,1,2 "
+                 "--freq=10 --cid=111 --range=100 --gain=1"
+              << std::endl;
+    std::cerr << "         " << argv[0]
+              << " --dev=/dev/i2c-0,/dev/i2c-1 --bus=0,0,1 "
+                 "--bus-address=112,113,112 --freq=10 --cid=111 --range=100 "
+                 "--gain=1"
+              << std::endl;
+    std::cerr << "         Without --poll-interval the driver waits after "
+                 "each ranging request for the longest range window plus "
+                 "5 ms, 70 ms for --range=255; with it, the sensors are "
+                 "polled until they report that ranging has completed. With "
+                 "--pipelined, each cycle reads the result of the previous "
+                 "ping and fires the next one right away, so ranging overlaps "
+                 "the wait for the next cycle; the period given by --freq "
+                 "must then cover the ranging time."
+              << std::endl;
+    std::cerr << "         --interference lists pairs of sensors, e.g. "
+                 "0-1,1-2, that must not range at the same time. Each cycle "
+                 "fires one time slot, and sensors in a slot never interfere "
+                 "with each other."
+              << std::endl;
+    std::cerr << "         --broadcast starts ranging on all sensors with "
+                 "one write to the general call address, so that all sensors "
+                 "measure at the same instant."
+              << std::endl;
+    std::cerr << "         --microseconds ranges in time of flight and "
+                 "converts to meters in the driver, with the speed of sound "
+                 "at the air temperature given by --temperature or, once "
+                 "received, by the TemperatureReading with sender stamp "
+                 "--temperature-id."
+              << std::endl;
+    std::cerr << "         --filter runs a sliding median, or a Hampel "
+                 "outlier filter, over the closest echo of each sensor. "
+                 "--publish chooses between the raw distance and the "
+                 "filtered one, the default once a filter is given, or "
+                 "both. The filtered distance is sent as "
+                 "opendlv.device.ultrasonic.FilteredDistanceReading."
+              << std::endl;
+    std::cerr << "         --track runs a constant-velocity Kalman filter "
+                 "on the closest echo of each sensor, and publishes its "
+                 "distance, closing speed and covariance every cycle as "
+                 "opendlv.device.ultrasonic.RangeTrack. Without an echo the "
+                 "track coasts for up to --track-max-coast seconds."
+              << std::endl;
+    std::cerr << "         --adaptive treats --range and --gain as upper "
+                 "limits, and adjusts both at runtime: the range window "
+                 "shrinks to just beyond the farthest echo, opening fully "
+                 "every " << GainRangeController::PROBE_INTERVAL
+              << "th window to look for objects farther away, and the gain "
+                 "drops while the closest echo jumps around and rises while "
+                 "most pings see nothing. With --poll-interval, or without "
+                 "it under --adaptive, a shorter window shortens the cycle."
+              << std::endl;
+    std::cerr << "         --speed-curve replaces --freq by a cycle rate, "
+                 "and --range by a range window, that follow the "
+                 "opendlv.proxy.GroundSpeedReading with sender stamp "
+                 "--speed-id, interpolated between the given points. The "
+                 "sensors listed in --forward follow the speed while the "
+                 "others keep their standstill rate and window; without "
+                 "--forward, all of them follow it. --range stays the upper "
+                 "limit of every window."
+              << std::endl;
+    std::cerr << "         --long-range interleaves the short windows "
+                 "given by --range with a long one: every --long-every-th "
+                 "round through the time slots pings with the long range "
+                 "register, and the next round restores the short windows. "
+                 "The closest echo of the long window is sent as "
+                 "opendlv.device.ultrasonic.LongWindowDistanceReading, and "
+                 "kept out of --filter. With --poll-interval, the short "
+                 "rounds also complete sooner, and the long round overruns "
+                 "the period given by --freq."
+              << std::endl;
+    std::cerr << "         --config-id accepts "
+                 "opendlv.device.ultrasonic.ConfigurationRequest messages "
+                 "with that sender stamp, which change the range, gain and "
+                 "--freq of a running driver. New values take the place of "
+                 "the ones given on the command line, and are written to the "
+                 "sensors between two pings, only when they change."
+              << std::endl;
+    std::cerr << "         --batch sends all containers published for "
+                 "one cycle of a bus with a single sendmmsg call instead of "
+                 "one sendto each. Every container still travels in a "
+                 "datagram of its own."
+              << std::endl;
+    std::cerr << "         --light also reads the light sensor of each "
+                 "SRF08, in the same transfer as the echoes, and publishes "
+                 "it as opendlv.device.ultrasonic.LightReading from 0 (dark) "
+                 "to about 1 (bright daylight)."
+              << std::endl;
+    std::cerr << "         Every echo is time-stamped when the ping reached "
+                 "the object, which is the time the ranging request was "
+                 "written plus half the time of flight of the echo."
+              << std::endl;
+    std::cerr << "         Cycles start at absolute deadlines. After an "
+                 "overrun, --overrun=skip drops the missed cycles while "
+                 "--overrun=catch-up runs them back to back."
+              << std::endl;
+    std::cerr << "         --realtime runs the acquisition threads with "
+                 "SCHED_FIFO, optionally pinned to one CPU, with all memory "
+                 "locked and its stack pre-faulted."
+              << std::endl;
     retCode = 1;
   } else {
-    uint32_t const ID{
-        (commandlineArguments["id"].size() != 0)
-            ? static_cast<uint32_t>(std::stoi(commandlineArguments["id"]))
-            : 0};
     int32_t VERBOSE{commandlineArguments.count("verbose") != 0};
     if (VERBOSE) {
       VERBOSE = std::stoi(commandlineArguments["verbose"]);
     }
     uint16_t const CID = std::stoi(commandlineArguments["cid"]);
     float const FREQ = std::stof(commandlineArguments["freq"]);
-
-    std::string const devNode = commandlineArguments["dev"];
-    int16_t deviceFile = open(devNode.c_str(), O_RDWR);
-    if (deviceFile < 0) {
-      std::cerr << "Failed to open the i2c bus." << std::endl;
+    float const DISPLAY_FREQ{
+        (commandlineArguments.count("display-freq") != 0)
+            ? std::stof(commandlineArguments["display-freq"])
+            : 10.0f};
+    bool const PIPELINED{commandlineArguments.count("pipelined") != 0};
+    bool const BROADCAST{commandlineArguments.count("broadcast") != 0};
+    bool const BATCH{commandlineArguments.count("batch") != 0};
+    bool const MICROSECONDS{commandlineArguments.count("microseconds") != 0};
+    bool const LIGHT{commandlineArguments.count("light") != 0};
+    bool const ADAPTIVE{commandlineArguments.count("adaptive") != 0};
+    uint32_t const ADAPTIVE_WINDOW{
+        (commandlineArguments.count("adaptive-window") != 0)
+            ? static_cast<uint32_t>(
+                  std::stoi(commandlineArguments["adaptive-window"]))
+            : 20};
+    bool const TRACK{commandlineArguments.count("track") != 0};
+    float const TRACK_RANGE_NOISE{
+        (commandlineArguments.count("track-range-noise") != 0)
+            ? std::stof(commandlineArguments["track-range-noise"])
+            : 0.03f};
+    float const TRACK_ACCELERATION_NOISE{
+        (commandlineArguments.count("track-acceleration-noise") != 0)
+            ? std::stof(commandlineArguments["track-acceleration-noise"])
+            : 3.0f};
+    float const TRACK_MAX_COAST{
+        (commandlineArguments.count("track-max-coast") != 0)
+            ? std::stof(commandlineArguments["track-max-coast"])
+            : 1.0f};
+    bool const FILTER{commandlineArguments.count("filter") != 0};
+    RollingFilter::Type filterType{RollingFilter::Type::Median};
+    if (FILTER && !RollingFilter::parseType(commandlineArguments["filter"],
+                                            filterType)) {
+      std::cerr << "--filter must be either median or hampel." << std::endl;
+      return 1;
+    }
+    uint32_t const FILTER_WINDOW{
+        (commandlineArguments.count("filter-window") != 0)
+            ? static_cast<uint32_t>(
+                  std::stoi(commandlineArguments["filter-window"]))
+            : 5U};
+    float const HAMPEL_THRESHOLD{
+        (commandlineArguments.count("hampel-threshold") != 0)
+            ? std::stof(commandlineArguments["hampel-threshold"])
+            : 3.0f};
+    std::string const PUBLISH{
+        (commandlineArguments.count("publish") != 0)
+            ? commandlineArguments["publish"]
+            : (FILTER ? "filtered" : "raw")};
+    bool const PUBLISH_RAW{PUBLISH == "raw" || PUBLISH == "both"};
+    bool const PUBLISH_FILTERED{PUBLISH == "filtered" || PUBLISH == "both"};
+    if ((!PUBLISH_RAW && !PUBLISH_FILTERED) || (PUBLISH_FILTERED && !FILTER) ||
+        FILTER_WINDOW < 1) {
+      std::cerr << "--publish must be raw, filtered or both, where filtered "
+                   "needs a --filter with a window of at least one sample."
+                << std::endl;
+      return 1;
+    }
+    float const TEMPERATURE{
+        (commandlineArguments.count("temperature") != 0)
+            ? std::stof(commandlineArguments["temperature"])
+            : 20.0f};
+    bool const FOLLOW_TEMPERATURE{
+        commandlineArguments.count("temperature-id") != 0};
+    uint32_t const TEMPERATURE_ID{
+        FOLLOW_TEMPERATURE
+            ? static_cast<uint32_t>(
+                  std::stoi(commandlineArguments["temperature-id"]))
+            : 0U};
+    SpeedCurve speedCurve;
+    if (commandlineArguments.count("speed-curve") != 0 &&
+        !speedCurve.parse(commandlineArguments["speed-curve"])) {
+      std::cerr << "--speed-curve must list speed:rate:window points in "
+                   "m/s, Hz and m, in order of increasing speed, e.g. "
+                   "0:2:1.5,2:10:4,8:20:11."
+                << std::endl;
       return 1;
     }
+    uint32_t const SPEED_ID{
+        (commandlineArguments.count("speed-id") != 0)
+            ? static_cast<uint32_t>(
+                  std::stoi(commandlineArguments["speed-id"]))
+            : 0U};
+    std::vector<uint32_t> const forwardIds{
+        (commandlineArguments["forward"].size() != 0)
+            ? parseList(commandlineArguments["forward"])
+            : std::vector<uint32_t>{}};
+    if (BROADCAST && !speedCurve.empty() && !forwardIds.empty()) {
+      std::cerr << "--broadcast fires all sensors at once, and cannot slow "
+                   "down the sensors left out of --forward."
+                << std::endl;
+      return 1;
+    }
+    bool const LONG_WINDOW{commandlineArguments.count("long-range") != 0};
+    uint32_t const LONG_RANGE{
+        LONG_WINDOW ? static_cast<uint32_t>(
+                          std::stoi(commandlineArguments["long-range"]))
+                    : 255U};
+    uint32_t const LONG_EVERY{
+        (commandlineArguments.count("long-every") != 0)
+            ? static_cast<uint32_t>(
+                  std::stoi(commandlineArguments["long-every"]))
+            : (LONG_WINDOW ? 10U : 0U)};
+    bool const FOLLOW_CONFIG{commandlineArguments.count("config-id") != 0};
+    uint32_t const CONFIG_ID{
+        FOLLOW_CONFIG ? static_cast<uint32_t>(
+                            std::stoi(commandlineArguments["config-id"]))
+                      : 0U};
+    bool const REALTIME{commandlineArguments.count("realtime") != 0};
+    int32_t const RT_PRIORITY{
+        (commandlineArguments.count("rt-priority") != 0)
+            ? std::stoi(commandlineArguments["rt-priority"])
+            : 50};
+    DeadlineScheduler::OverrunPolicy overrunPolicy{
+        DeadlineScheduler::OverrunPolicy::Skip};
+    if (commandlineArguments.count("overrun") != 0 &&
+        !DeadlineScheduler::parsePolicy(commandlineArguments["overrun"],
+                                        overrunPolicy)) {
+      std::cerr << "--overrun must be either skip or catch-up." << std::endl;
+      return 1;
+    }
+    bool const POLL{commandlineArguments.count("poll-interval") != 0};
+    std::chrono::duration<double, std::milli> const POLL_INTERVAL{
+        POLL ? std::stod(commandlineArguments["poll-interval"]) : 0.0};
+    std::chrono::duration<double, std::milli> const POLL_TIMEOUT{
+        (commandlineArguments.count("poll-timeout") != 0)
+            ? std::stod(commandlineArguments["poll-timeout"])
+            : 70.0};
 
-    uint8_t const address = std::stoi(commandlineArguments["bus-address"]);
-    uint8_t const range = std::stoi(commandlineArguments["range"]);
-    uint8_t const gain = std::stoi(commandlineArguments["gain"]);
+    std::vector<uint32_t> const addresses{
+        parseList(commandlineArguments["bus-address"])};
+    std::vector<uint32_t> const ids{
+        (commandlineArguments["id"].size() != 0)
+            ? parseList(commandlineArguments["id"])
+            : std::vector<uint32_t>{}};
+    std::vector<uint32_t> const ranges{
+        parseList(commandlineArguments["range"])};
+    std::vector<uint32_t> const gains{parseList(commandlineArguments["gain"])};
+    bool const ALL_ECHOES{commandlineArguments.count("all-echoes") != 0};
+    std::vector<uint32_t> const echoes{
+        (commandlineArguments["echoes"].size() != 0)
+            ? parseList(commandlineArguments["echoes"])
+            : std::vector<uint32_t>{ALL_ECHOES ? srf08::MAX_ECHOES : 1U}};
 
-    int8_t status = ioctl(deviceFile, I2C_SLAVE, address);
-    if (status < 0) {
-      std::cerr << "Could not acquire bus access for device " << devNode << "."
+    uint32_t const sensorCount = static_cast<uint32_t>(addresses.size());
+    if ((ids.size() > 1 && ids.size() != sensorCount) ||
+        (ids.size() == 1 && sensorCount > 1) ||
+        (ranges.size() != 1 && ranges.size() != sensorCount) ||
+        (gains.size() != 1 && gains.size() != sensorCount) ||
+        (echoes.size() != 1 && echoes.size() != sensorCount)) {
+      std::cerr << "The lists given to --bus-address, --id, --range, --gain "
+                   "and --echoes must have the same length."
                 << std::endl;
       return 1;
     }
-
-    uint8_t parseFirmwareBuffer[1];
-    parseFirmwareBuffer[0] = 0x00;
-    status = write(deviceFile, parseFirmwareBuffer, 1);
-    if (status != 1) {
-      std::cerr << "Could not write firmware request to device on " << devNode
-                << "." << std::endl;
+    if (LONG_WINDOW &&
+        (LONG_RANGE > 255 || LONG_EVERY < 2 ||
+         std::any_of(ranges.begin(), ranges.end(),
+                     [&LONG_RANGE](uint32_t range) {
+                       return range >= LONG_RANGE;
+                     }))) {
+      std::cerr << "--long-range must be a range register above every "
+                   "--range, and --long-every at least 2."
+                << std::endl;
       return 1;
     }
+    for (uint32_t const n : echoes) {
+      if (n < 1 || n > srf08::MAX_ECHOES) {
+        std::cerr << "--echoes must be between 1 and "
+                  << static_cast<int32_t>(srf08::MAX_ECHOES) << "."
+                  << std::endl;
+        return 1;
+      }
+    }
 
-    uint8_t firmwareBuffer[1];
-    status = read(deviceFile, firmwareBuffer, 1);
-    if (status != 1) {
-      std::cerr << "Could not read firmware from device on " << devNode << "."
+    /* Every sensor is placed on one of the buses given to --dev, and keeps
+     * its position among the sensors of that bus. */
+    std::vector<std::string> const devNodes{
+        splitList(commandlineArguments["dev"])};
+    uint32_t const busCount{static_cast<uint32_t>(devNodes.size())};
+    std::vector<uint32_t> const sensorBuses{
+        (commandlineArguments["bus"].size() != 0)
+            ? parseList(commandlineArguments["bus"])
+            : std::vector<uint32_t>(sensorCount, 0)};
+    if (busCount == 0 || sensorBuses.size() != sensorCount ||
+        (busCount > 1 && commandlineArguments["bus"].size() == 0)) {
+      std::cerr << "With several buses given to --dev, --bus must list the "
+                   "bus of each sensor."
+                << std::endl;
+      return 1;
+    }
+    std::vector<uint32_t> busSensorCounts(busCount, 0);
+    std::vector<uint32_t> busPositions(sensorCount, 0);
+    for (uint32_t i = 0; i < sensorCount; i++) {
+      if (sensorBuses[i] >= busCount) {
+        std::cerr << "--bus must refer to one of the " << busCount
+                  << " device node(s) given to --dev." << std::endl;
+        return 1;
+      }
+      busPositions[i] = busSensorCounts[sensorBuses[i]]++;
+    }
+    /* Firing slots and the display keep one bit or entry per sensor of a
+     * bus. */
+    static_assert(srf08::MAX_SENSORS_PER_BUS <= FiringSchedule::MAX_SENSORS,
+                  "Every sensor of a bus needs a bit in the slot masks.");
+    for (uint32_t b = 0; b < busCount; b++) {
+      if (busSensorCounts[b] > srf08::MAX_SENSORS_PER_BUS) {
+        std::cerr << "At most "
+                  << static_cast<int32_t>(srf08::MAX_SENSORS_PER_BUS)
+                  << " sensors fit on one bus, but " << busSensorCounts[b]
+                  << " are given for " << devNodes[b] << "." << std::endl;
+        return 1;
+      }
+    }
+    if (VERBOSE == 2 && busCount > 1) {
+      std::cerr << "--verbose=2 shows the sensors of a single bus only."
+                << std::endl;
+      return 1;
+    }
+    std::vector<int32_t> rtCpus;
+    for (auto const &cpu :
+         splitList(commandlineArguments["rt-cpu"])) {
+      rtCpus.push_back(std::stoi(cpu));
+    }
+    if (rtCpus.size() > 1 && rtCpus.size() != busCount) {
+      std::cerr << "--rt-cpu must give one CPU, or one CPU per bus."
                 << std::endl;
       return 1;
     }
 
-    std::clog << "Connected with the SRF08 device on " << devNode
-              << ". Reported firmware version '"
-              << static_cast<int32_t>(firmwareBuffer[0]) << "'." << std::endl;
+    std::vector<std::unique_ptr<FiringSchedule>> schedules;
+    for (uint32_t b = 0; b < busCount; b++) {
+      schedules.emplace_back(new FiringSchedule{busSensorCounts[b]});
+    }
+    for (auto const &pair :
+         splitList(commandlineArguments["interference"])) {
+      std::vector<std::string> const pairIds{stringtoolbox::split(pair, '-')};
+      bool added{false};
+      if (pairIds.size() == 2) {
+        uint32_t const a{static_cast<uint32_t>(std::stoi(pairIds[0]))};
+        uint32_t const b{static_cast<uint32_t>(std::stoi(pairIds[1]))};
+        uint32_t const ia{ids.empty() ? a : static_cast<uint32_t>(
+            std::find(ids.begin(), ids.end(), a) - ids.begin())};
+        uint32_t const ib{ids.empty() ? b : static_cast<uint32_t>(
+            std::find(ids.begin(), ids.end(), b) - ids.begin())};
+        /* Buses run unsynchronised, so only sensors on one bus can be
+         * kept apart. */
+        added = ia < sensorCount && ib < sensorCount &&
+                sensorBuses[ia] == sensorBuses[ib] &&
+                schedules[sensorBuses[ia]]->addInterference(busPositions[ia],
+                                                            busPositions[ib]);
+      }
+      if (!added) {
+        std::cerr << "--interference pair '" << pair
+                  << "' does not name two different sensor ids on the same "
+                     "bus."
+                  << std::endl;
+        return 1;
+      }
+    }
+    for (auto &schedule : schedules) {
+      schedule->build();
+      if (BROADCAST && schedule->slotCount() > 1) {
+        std::cerr << "--broadcast fires all sensors at once and cannot be "
+                     "combined with interfering sensors."
+                  << std::endl;
+        return 1;
+      }
+    }
 
-    cluon::OD4Session od4{CID};
+    std::vector<std::unique_ptr<LinuxI2cBus>> buses;
+    std::vector<std::unique_ptr<BusAcquisition>> acquisitions;
+    for (uint32_t b = 0; b < busCount; b++) {
+      buses.emplace_back(new LinuxI2cBus{devNodes[b]});
+      if (!buses[b]->isOpen()) {
+        std::cerr << "Failed to open the i2c bus " << devNodes[b] << "."
+                  << std::endl;
+        return 1;
+      }
+      AcquisitionOptions options;
+      options.freq = FREQ;
+      options.overrunPolicy = overrunPolicy;
+      options.pipelined = PIPELINED;
+      options.broadcast = BROADCAST;
+      options.poll = POLL;
+      options.pollInterval = POLL_INTERVAL;
+      options.pollTimeout = POLL_TIMEOUT;
+      options.realtime = REALTIME;
+      options.rtPriority = RT_PRIORITY;
+      options.rtCpu = rtCpus.empty() ? -1
+                                     : rtCpus[(rtCpus.size() == 1) ? 0 : b];
+      options.adaptive = ADAPTIVE;
+      options.adaptiveWindow = ADAPTIVE_WINDOW;
+      options.speedCurve = speedCurve.empty() ? nullptr : &speedCurve;
+      options.longRange = static_cast<uint8_t>(LONG_RANGE);
+      options.longEvery = LONG_WINDOW ? LONG_EVERY : 0U;
+      acquisitions.emplace_back(new BusAcquisition{*buses[b], options});
+      acquisitions[b]->setSlotCount(schedules[b]->slotCount());
+    }
+
+    std::vector<uint32_t> forwardMasks(busCount, 0);
+    for (uint32_t i = 0; i < sensorCount; i++) {
+      Srf08Config config;
+      config.address = static_cast<uint8_t>(addresses[i]);
+      config.id = ids.empty() ? i : ids[i];
+      config.range =
+          static_cast<uint8_t>(ranges.size() == 1 ? ranges[0] : ranges[i]);
+      config.gain =
+          static_cast<uint8_t>(gains.size() == 1 ? gains[0] : gains[i]);
+      config.echoes =
+          static_cast<uint8_t>(echoes.size() == 1 ? echoes[0] : echoes[i]);
+      config.microseconds = MICROSECONDS;
+      config.light = LIGHT;
+      std::string const &devNode{devNodes[sensorBuses[i]]};
+      Srf08Array &array{acquisitions[sensorBuses[i]]->array()};
+      Srf08 &sensor = array.add(config);
+      sensor.setSpeedOfSound(srf08::speedOfSound(TEMPERATURE));
+      array.setSlotMask(busPositions[i],
+                        schedules[sensorBuses[i]]->slotMask(busPositions[i]));
+      if (std::find(forwardIds.begin(), forwardIds.end(), config.id) !=
+          forwardIds.end()) {
+        forwardMasks[sensorBuses[i]] |= 1U << busPositions[i];
+      }
+
+      uint8_t firmware{0};
+      if (!sensor.readFirmware(firmware)) {
+        std::cerr << "Could not read firmware from device "
+                  << static_cast<int32_t>(config.address) << " on " << devNode
+                  << "." << std::endl;
+        return 1;
+      }
+      std::clog << "Connected with the SRF08 device "
+                << static_cast<int32_t>(config.address) << " on " << devNode
+                << ". Reported firmware version '"
+                << static_cast<int32_t>(firmware) << "'." << std::endl;
 
-    uint8_t buf[2];
-    buf[0] = 0x02;
-    buf[1] = range;
+      if (!sensor.writeRange(config.range)) {
+        std::cerr << "Error in changing the range." << std::endl;
+      }
+      if (!sensor.writeGain(config.gain)) {
+        std::cerr << "Error in changing the gain." << std::endl;
+      }
+    }
 
-    /* Reducing echo listening time, and thus range to 43mm * buf[1] -
-     * max/default is 65ms which is approx. 11m */
-    uint8_t test = write(deviceFile, buf, 2);
-    if (test != 2) {
-      std::cout << "Error in changing the range." << std::endl;
+    for (uint32_t b = 0; b < busCount; b++) {
+      acquisitions[b]->setForwardMask(forwardMasks[b]);
+      std::clog << "Firing " << devNodes[b] << " in "
+                << schedules[b]->slotCount() << " time slot(s), each sensor "
+                << "ranging at:";
+      auto &sensors = acquisitions[b]->array().sensors();
+      for (uint32_t i = 0; i < sensors.size(); i++) {
+        std::clog << " " << sensors[i]->id() << ": "
+                  << schedules[b]->rate(i, FREQ) << " Hz";
+      }
+      std::clog << "." << std::endl;
     }
 
-    buf[0] = 0x01;
-    buf[1] = gain;
+    cluon::OD4Session od4{CID};
+    if (MICROSECONDS && FOLLOW_TEMPERATURE) {
+      /* Called from the OD4 receiver thread, the sensors pick the new speed
+       * of sound up with their next conversion. */
+      od4.dataTrigger(
+          opendlv::proxy::TemperatureReading::ID(),
+          [&acquisitions, &TEMPERATURE_ID](cluon::data::Envelope &&envelope) {
+            if (envelope.senderStamp() != TEMPERATURE_ID) {
+              return;
+            }
+            float const temperature{
+                cluon::extractMessage<opendlv::proxy::TemperatureReading>(
+                    std::move(envelope))
+                    .temperature()};
+            if (temperature < -60.0f || temperature > 80.0f) {
+              return;
+            }
+            float const speedOfSound{srf08::speedOfSound(temperature)};
+            for (auto &acquisition : acquisitions) {
+              for (auto &sensor : acquisition->array().sensors()) {
+                sensor->setSpeedOfSound(speedOfSound);
+              }
+            }
+          });
+    }
 
-    /*Reducing rate of echos fired by sensor to lower/higher than default value
-    of 65ms
-    This can lead to false readings if echos from previous pings are too fast */
-    test = write(deviceFile, buf, 2);
-    if (test != 2) {
-      std::cerr << "Error in changing the gain." << std::endl;
+    if (!speedCurve.empty()) {
+      /* Called from the OD4 receiver thread, every bus applies the new
+       * speed right before its next firing. */
+      od4.dataTrigger(
+          opendlv::proxy::GroundSpeedReading::ID(),
+          [&acquisitions, &SPEED_ID](cluon::data::Envelope &&envelope) {
+            if (envelope.senderStamp() != SPEED_ID) {
+              return;
+            }
+            float const groundSpeed{
+                cluon::extractMessage<opendlv::proxy::GroundSpeedReading>(
+                    std::move(envelope))
+                    .groundSpeed()};
+            for (auto &acquisition : acquisitions) {
+              acquisition->setGroundSpeed(groundSpeed);
+            }
+          });
     }
 
-    if (VERBOSE == 2) {
-      initscr();
+    if (FOLLOW_CONFIG) {
+      /* Called from the OD4 receiver thread, the only thread that queues
+       * requests. Every bus applies them right before its next firing. */
+      od4.dataTrigger(
+          opendlv::device::ultrasonic::ConfigurationRequest::ID(),
+          [&acquisitions, &speedCurve,
+           &CONFIG_ID](cluon::data::Envelope &&envelope) {
+            if (envelope.senderStamp() != CONFIG_ID) {
+              return;
+            }
+            auto const request{cluon::extractMessage<
+                opendlv::device::ultrasonic::ConfigurationRequest>(
+                std::move(envelope))};
+            if (request.freq() > 0.0f && !speedCurve.empty()) {
+              std::cerr << "Ignored the requested rate of " << request.freq()
+                        << " Hz, since --speed-curve sets the rate."
+                        << std::endl;
+            }
+            /* A request without a sensor id is one entry per bus. */
+            SensorConfiguration configuration;
+            configuration.id = request.hasSensorId()
+                                   ? static_cast<int64_t>(request.sensorId())
+                                   : -1;
+            configuration.range =
+                request.hasRange() ? static_cast<int64_t>(request.range())
+                                   : -1;
+            configuration.gain =
+                request.hasGain() ? static_cast<int64_t>(request.gain()) : -1;
+            for (auto &acquisition : acquisitions) {
+              acquisition->setFrequency(request.freq());
+              auto const &sensors = acquisition->array().sensors();
+              auto const named{[&request](
+                                   std::unique_ptr<Srf08> const &sensor) {
+                return sensor->id() == request.sensorId();
+              }};
+              if ((!request.hasRange() && !request.hasGain()) ||
+                  (request.hasSensorId() &&
+                   std::none_of(sensors.begin(), sensors.end(), named))) {
+                continue;
+              }
+              std::string const target{
+                  request.hasSensorId()
+                      ? "SRF08 " + std::to_string(request.sensorId())
+                      : "the SRF08s on " +
+                            acquisition->array().bus().devNode()};
+              switch (acquisition->configure(configuration)) {
+                case BusAcquisition::Request::Queued:
+                  break;
+                case BusAcquisition::Request::Invalid:
+                  std::cerr << "Ignored the configuration request for "
+                            << target
+                            << ", whose range or gain is out of bounds."
+                            << std::endl;
+                  break;
+                case BusAcquisition::Request::QueueFull:
+                  std::cerr << "Dropped the configuration request for "
+                            << target << ", since "
+                            << BusAcquisition::REQUEST_CAPACITY
+                            << " requests are already waiting." << std::endl;
+                  break;
+              }
+            }
+          });
     }
-    auto atFrequency{[&deviceFile, &ID, &VERBOSE, &od4]() -> bool {
-      uint8_t commandBuffer[2];
-      commandBuffer[0] = 0x00; /* SRF08 Command Register */
-      commandBuffer[1] = 0x51;
 
-      /* By writing 0x51 to the Command Register, the Ranging Mode will be in
-       * centimeters */
-      uint8_t res = write(deviceFile, commandBuffer, 2);
-      if (res != 2) {
-        std::cerr << "Could not write ranging request." << std::endl;
-        return false;
-      }
-      std::this_thread::sleep_for(std::chrono::duration<double>(0.07));
-
-      uint8_t data{0x02}; /* SRF08 Range Register */
-      uint8_t buffer[34]; /* Array of bytes, need to store 17 pairs of Echo High
-                             & Low Bytes */
-
-      res = write(deviceFile, &data,
-                  1); /* Write to the Range Register to shorten ranging time */
-      res += read(deviceFile, &buffer,
-                  34); /* Read 1st to 17th Echo High & Low Byte */
-      if (res != 35) {
-        std::cerr << "Could not read data." << std::endl;
-        return false;
+    std::unique_ptr<Display> display{
+        (VERBOSE == 2) ? new Display{DISPLAY_FREQ} : nullptr};
+    /* Readings are encoded into a preallocated buffer and sent on the OD4
+     * multicast group directly, so the steady-state loop does not allocate.
+     * The delegates are wrapped into their std::function once, up front.
+     * With --batch, the containers of one cycle are sent together. */
+    Od4Publisher publisher{CID, BATCH};
+    if (!publisher.isOpen()) {
+      std::cerr << "Failed to open the OD4 publishing socket." << std::endl;
+      return 1;
+    }
+    auto const afterCycle{[&display, &od4]() -> bool {
+      if (display) {
+        display->commit();
       }
-      // float lumen = static_cast<float>(data[0]) / 248.0f * 1000.0f;
-      std::vector<float> val;
-      for (uint8_t i = 0; i < 33; i += 2) {
-        /* One result from a ranging request is a 16 bit unsigned integer, high
-        byte first A value of zero means no objects were detected */
-        if (buffer[i] == 0 && buffer[i + 1] == 0) {
-          break;
+      return od4.isRunning() &&
+             !cluon::TerminateHandler::instance().isTerminated.load();
+    }};
+
+    /* Filters and trackers are kept per sensor, in the order of sensorIds,
+     * and looked up by id in the publisher thread. */
+    std::vector<uint32_t> sensorIds;
+    std::vector<std::unique_ptr<RollingFilter>> filters;
+    std::vector<std::unique_ptr<RangeTracker>> trackers;
+    for (auto &acquisition : acquisitions) {
+      for (auto &sensor : acquisition->array().sensors()) {
+        sensorIds.push_back(sensor->id());
+        if (PUBLISH_FILTERED) {
+          filters.emplace_back(
+              new RollingFilter{filterType, FILTER_WINDOW, HAMPEL_THRESHOLD});
+        }
+        if (TRACK) {
+          trackers.emplace_back(new RangeTracker{
+              TRACK_RANGE_NOISE, TRACK_ACCELERATION_NOISE,
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::duration<double>(TRACK_MAX_COAST))});
         }
-        uint16_t rangeCm = (buffer[i] << 8) | buffer[i + 1];
-        val.push_back(static_cast<float>(rangeCm) /
-                      100.0f); /* Convert result in centimeters to meters */
       }
+    }
 
-      if (!val.empty()) {
-        opendlv::proxy::DistanceReading distanceReading;
-        // Return the first echo (closest detection)
-        distanceReading.distance(val.at(0));
+    /* The acquisition threads only queue their readings, and encoding,
+     * filtering, sending and logging all happen in the publisher thread. */
+    EnvelopeEncoder encoder;
+    PublisherThread publisherThread{
+        busCount, [&VERBOSE, &ALL_ECHOES, &PUBLISH_RAW, &PUBLISH_FILTERED,
+                   &LONG_WINDOW, &LONG_RANGE, &publisher, &encoder,
+                   &sensorIds, &filters,
+                   &trackers](QueuedReading const &reading) {
+          if (reading.endOfCycle) {
+            publisher.flush();
+            return;
+          }
+          Srf08Echoes const &val = reading.echoes;
+          /* Every --range is below the long one, so the range register of
+           * the ping tells its window apart. */
+          bool const longWindow{LONG_WINDOW && val.range == LONG_RANGE};
+          uint32_t const sensorIndex{static_cast<uint32_t>(
+              std::find(sensorIds.begin(), sensorIds.end(), reading.id) -
+              sensorIds.begin())};
+          if (!trackers.empty()) {
+            /* Tracks are published every cycle, and coast on a prediction
+             * when the sensor saw nothing. */
+            RangeTracker &tracker = *trackers[sensorIndex];
+            RangeTracker::TimePoint time{val.fireTime};
+            if (val.count > 0) {
+              time = Srf08::reflectionTime(val.fireTime, val.distances[0],
+                                           val.speedOfSound);
+              tracker.update(time, val.distances[0]);
+            } else {
+              tracker.predict(time);
+            }
+            if (tracker.isTracking()) {
+              publisher.sendTrack(encoder, tracker.track(),
+                                  cluon::time::convert(time), reading.id);
+            }
+          }
+          /* Return the first echo (closest detection), and with
+           * --all-echoes every echo of the ping in one message. Both are
+           * sampled when the ping reached the closest object. Long-window
+           * echoes have a message of their own and bypass the filter. */
+          uint32_t const echoCount{
+              (ALL_ECHOES || val.count == 0) ? val.count : 1U};
+          if (val.count > 0) {
+            cluon::data::TimeStamp const sampleTime{
+                cluon::time::convert(Srf08::reflectionTime(
+                    val.fireTime, val.distances[0], val.speedOfSound))};
+            if (longWindow) {
+              publisher.sendLongWindowDistance(encoder, val.distances[0],
+                                               val.range, sampleTime,
+                                               reading.id);
+            }
+            if (PUBLISH_FILTERED && !longWindow) {
+              float const filtered{
+                  filters[sensorIndex]->filter(val.distances[0])};
+              publisher.sendFilteredDistance(encoder, filtered, sampleTime,
+                                             reading.id);
+            }
+            if (PUBLISH_RAW && !longWindow) {
+              publisher.sendDistance(encoder, val.distances[0], sampleTime,
+                                     reading.id);
+            }
+            if (ALL_ECHOES) {
+              publisher.sendEchoes(encoder, val, sampleTime, reading.id);
+            }
+          }
+          /* The light level is a message type of its own, sent with the
+           * sensor id as sender stamp. */
+          float const lightLevel{static_cast<float>(val.light) /
+                                 srf08::LIGHT_FULL_SCALE};
+          if (val.hasLight) {
+            publisher.sendLight(encoder, lightLevel,
+                                cluon::time::convert(val.fireTime),
+                                reading.id);
+          }
+          if (VERBOSE == 1) {
+            if (echoCount > 0) {
+              std::clog << "SRF08 " << reading.id << " distance reading is "
+                        << val.distances[0] << "m";
+              for (uint32_t i = 1; i < echoCount; i++) {
+                std::clog << ", " << val.distances[i] << "m";
+              }
+              std::clog << "." << std::endl;
+            }
+            if (val.hasLight) {
+              std::clog << "SRF08 " << reading.id << " light level is "
+                        << lightLevel << "." << std::endl;
+            }
+          }
+        }};
 
-        cluon::data::TimeStamp sampleTime = cluon::time::now();
-        od4.send(distanceReading, sampleTime, ID);
-        if (VERBOSE == 1) {
-          std::clog << "SRF08 distance reading is "
-                    << distanceReading.distance() << "m." << std::endl;
-        }
-      }
+    if (REALTIME) {
+      /* Locking applies to the whole process, the scheduling policy,
+       * affinity and stack of each bus thread are set by the thread. */
+      std::clog << "Real-time mode: mlockall "
+                << (realtime::lockMemory() ? "done" : "failed") << "."
+                << std::endl;
+    }
 
-      if (VERBOSE == 2) {
-        std::stringstream ss;
-        clear();
-        mvprintw(1, 1, ("size of data: " + std::to_string(val.size())).c_str());
-        for (uint8_t i = 0; i < val.size(); i++) {
-          std::string str =
-              std::to_string(i) + ": " + std::to_string(val.at(i));
-          mvprintw(i + 2, 1, str.c_str());
-        }
-        refresh(); /* Print it on to the real screen */
-      }
-      return od4.isRunning();
-    }};
+    for (uint32_t b = 0; b < busCount; b++) {
+      acquisitions[b]->start(
+          [b, &TRACK, &publisherThread, &display](Srf08 &sensor,
+                                                  Srf08Echoes const &val) {
+            if (val.count > 0 || val.hasLight || TRACK) {
+              QueuedReading reading;
+              reading.id = sensor.id();
+              reading.echoes = val;
+              publisherThread.push(b, reading);
+            }
 
-    od4.timeTrigger(FREQ, atFrequency);
-    if (VERBOSE == 2) {
-      endwin(); /* End curses mode      */
+            if (display) {
+              display->update(sensor.id(), val);
+            }
+          },
+          [b, &BATCH, &publisherThread, &afterCycle]() -> bool {
+            if (BATCH) {
+              QueuedReading endOfCycle;
+              endOfCycle.endOfCycle = true;
+              publisherThread.push(b, endOfCycle);
+            }
+            return afterCycle();
+          });
+    }
+    for (auto &acquisition : acquisitions) {
+      acquisition->join();
+    }
+    publisherThread.stop();
+    publisher.flush();
+    display.reset();
+    for (uint32_t b = 0; b < busCount; b++) {
+      if (publisherThread.overflows(b) > 0) {
+        std::clog << "Dropped " << publisherThread.overflows(b)
+                  << " readings from " << devNodes[b]
+                  << " because the publisher queue was full." << std::endl;
+      }
     }
+    uint64_t const sendCalls{publisher.sendCalls()};
+    std::clog << "Published " << publisherThread.published()
+              << " readings in " << publisher.sends() << " containers and "
+              << sendCalls << " calls to " << (BATCH ? "sendmmsg" : "sendto")
+              << ", spending on average "
+              << ((sendCalls > 0)
+                      ? publisher.sendNanoseconds() / sendCalls / 1000.0
+                      : 0.0)
+              << " us and at most " << publisher.maxSendNanoseconds() / 1000.0
+              << " us per call." << std::endl;
   }
   return retCode;
 }
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "publisher-thread.hpp"
+
+uint32_t const PublisherThread::RING_CAPACITY;
+
+PublisherThread::PublisherThread(
+    uint32_t producerCount,
+    std::function<void(QueuedReading const &)> delegate)
+    : m_delegate{delegate},
+      m_rings{},
+      m_overflows{new std::atomic<uint64_t>[producerCount]},
+      m_published{0},
+      m_running{true},
+      m_pending{},
+      m_thread{} {
+  for (uint32_t i = 0; i < producerCount; i++) {
+    m_rings.emplace_back(new ReadingRing);
+    m_overflows[i].store(0);
+  }
+  sem_init(&m_pending, 0, 0);
+  m_thread = std::thread(&PublisherThread::run, this);
+}
+
+PublisherThread::~PublisherThread() {
+  stop();
+  sem_destroy(&m_pending);
+}
+
+bool PublisherThread::push(uint32_t producer,
+                           QueuedReading const &reading) noexcept {
+  if (!m_rings[producer]->push(reading)) {
+    m_overflows[producer].fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  sem_post(&m_pending);
+  return true;
+}
+
+uint64_t PublisherThread::overflows(uint32_t producer) const noexcept {
+  return m_overflows[producer].load();
+}
+
+uint64_t PublisherThread::published() const noexcept {
+  return m_published.load();
+}
+
+void PublisherThread::stop() noexcept {
+  if (m_thread.joinable()) {
+    m_running.store(false);
+    sem_post(&m_pending);
+    m_thread.join();
+  }
+}
+
+void PublisherThread::run() noexcept {
+  /* Every post stands for one queued reading, except for the final one from
+   * stop(). Readings still queued at that point are published first. */
+  QueuedReading reading;
+  uint32_t next{0};
+  uint32_t const ringCount{static_cast<uint32_t>(m_rings.size())};
+  while (true) {
+    while (sem_wait(&m_pending) != 0) {
+    }
+    bool popped{false};
+    for (uint32_t i = 0; i < ringCount && !popped; i++) {
+      popped = m_rings[next]->pop(reading);
+      next = (next + 1) % ringCount;
+    }
+    if (popped) {
+      if (nullptr != m_delegate) {
+        m_delegate(reading);
+      }
+      if (!reading.endOfCycle) {
+        m_published.fetch_add(1, std::memory_order_relaxed);
+      }
+    } else if (!m_running.load()) {
+      break;
+    }
+  }
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PUBLISHER_THREAD_HPP
+#define PUBLISHER_THREAD_HPP
+
+#include <semaphore.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "spsc-ring.hpp"
+#include "srf08.hpp"
+
+/* A reading of one sensor, or the mark that a bus has finished a cycle. */
+struct QueuedReading {
+  uint32_t id{0};
+  Srf08Echoes echoes{};
+  bool endOfCycle{false};
+};
+
+/* Moves publishing out of the acquisition threads. Each producer, one per
+ * bus, pushes its readings into its own lock-free ring, and a single
+ * publisher thread hands them to the delegate. A full ring drops the
+ * reading and counts the overflow instead of stalling acquisition. The
+ * producers wake the publisher through a semaphore, which only enters the
+ * kernel while the publisher is actually waiting. End-of-cycle marks are
+ * handed to the delegate like readings, but not counted as published. */
+class PublisherThread {
+ private:
+  PublisherThread(PublisherThread const &) = delete;
+  PublisherThread(PublisherThread &&) = delete;
+  PublisherThread &operator=(PublisherThread const &) = delete;
+  PublisherThread &operator=(PublisherThread &&) = delete;
+
+ public:
+  static uint32_t const RING_CAPACITY{256};
+  typedef SpscRing<QueuedReading, RING_CAPACITY> ReadingRing;
+
+ public:
+  PublisherThread(uint32_t producerCount,
+                  std::function<void(QueuedReading const &)> delegate);
+  ~PublisherThread();
+
+ public:
+  bool push(uint32_t producer, QueuedReading const &reading) noexcept;
+  uint64_t overflows(uint32_t producer) const noexcept;
+  uint64_t published() const noexcept;
+  void stop() noexcept;
+
+ private:
+  void run() noexcept;
+
+ private:
+  std::function<void(QueuedReading const &)> m_delegate;
+  std::vector<std::unique_ptr<ReadingRing>> m_rings;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_overflows;
+  std::atomic<uint64_t> m_published;
+  std::atomic<bool> m_running;
+  sem_t m_pending;
+  std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "range-tracker.hpp"
+
+namespace {
+/* Standard deviation of the closing speed of a new track, in m/s. */
+double const INITIAL_SPEED_DEVIATION{5.0};
+/* Squared Mahalanobis distance beyond which a measurement is rejected. */
+double const GATE{16.0};
+}  // namespace
+
+RangeTracker::RangeTracker(float rangeNoise, float accelerationNoise,
+                           std::chrono::microseconds maxCoast) noexcept
+    : m_rangeVariance{static_cast<double>(rangeNoise) * rangeNoise},
+      m_accelerationVariance{static_cast<double>(accelerationNoise) *
+                             accelerationNoise},
+      m_maxCoast{maxCoast},
+      m_tracking{false},
+      m_time{},
+      m_lastMeasurement{},
+      m_distance{0.0},
+      m_rate{0.0},
+      m_p00{0.0},
+      m_p01{0.0},
+      m_p11{0.0} {}
+
+bool RangeTracker::update(TimePoint time, float distance) noexcept {
+  if (!m_tracking) {
+    m_tracking = true;
+    m_time = time;
+    m_lastMeasurement = time;
+    m_distance = distance;
+    m_rate = 0.0;
+    m_p00 = m_rangeVariance;
+    m_p01 = 0.0;
+    m_p11 = INITIAL_SPEED_DEVIATION * INITIAL_SPEED_DEVIATION;
+    return true;
+  }
+  if (!predict(time)) {
+    return update(time, distance);
+  }
+
+  double const innovation{distance - m_distance};
+  double const s{m_p00 + m_rangeVariance};
+  if (innovation * innovation > GATE * s) {
+    return false;
+  }
+  double const k0{m_p00 / s};
+  double const k1{m_p01 / s};
+  m_distance += k0 * innovation;
+  m_rate += k1 * innovation;
+  double const p00{m_p00};
+  double const p01{m_p01};
+  m_p00 = (1.0 - k0) * p00;
+  m_p01 = (1.0 - k0) * p01;
+  m_p11 -= k1 * p01;
+  m_lastMeasurement = time;
+  return true;
+}
+
+bool RangeTracker::predict(TimePoint time) noexcept {
+  if (!m_tracking) {
+    return false;
+  }
+  if (time - m_lastMeasurement > m_maxCoast) {
+    m_tracking = false;
+    return false;
+  }
+  /* Samples that arrive out of order are not propagated backwards. */
+  if (time > m_time) {
+    propagate(std::chrono::duration<double>(time - m_time).count());
+    m_time = time;
+  }
+  return true;
+}
+
+bool RangeTracker::isTracking() const noexcept { return m_tracking; }
+
+RangeTrack RangeTracker::track() const noexcept {
+  RangeTrack track;
+  track.distance = static_cast<float>(m_distance);
+  track.closingSpeed = static_cast<float>(-m_rate);
+  track.distanceVariance = static_cast<float>(m_p00);
+  track.closingSpeedVariance = static_cast<float>(m_p11);
+  track.covariance = static_cast<float>(-m_p01);
+  return track;
+}
+
+void RangeTracker::propagate(double dt) noexcept {
+  /* x = F x and P = F P F' + Q, with F = [1 dt; 0 1] and Q from white noise
+   * acceleration over dt. */
+  m_distance += m_rate * dt;
+  double const dt2{dt * dt};
+  m_p00 += 2.0 * dt * m_p01 + dt2 * m_p11 +
+           m_accelerationVariance * dt2 * dt2 / 4.0;
+  m_p01 += dt * m_p11 + m_accelerationVariance * dt2 * dt / 2.0;
+  m_p11 += m_accelerationVariance * dt2;
+}
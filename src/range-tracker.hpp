@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RANGE_TRACKER_HPP
+#define RANGE_TRACKER_HPP
+
+#include <chrono>
+#include <cstdint>
+
+/* Estimated distance to the closest object and how fast it approaches, with
+ * the covariance of both in m^2, m^2/s and m^2/s^2. */
+struct RangeTrack {
+  float distance{0.0f};
+  float closingSpeed{0.0f}; /* Positive while the object comes closer */
+  float distanceVariance{0.0f};
+  float closingSpeedVariance{0.0f};
+  float covariance{0.0f};
+};
+
+/* Constant-velocity Kalman filter on the distance to the closest echo. The
+ * filter is propagated over the actual time between measurements, so
+ * dropped samples and jittering cycles only widen the covariance. Missing
+ * echoes are coasted through with a prediction, and measurements far
+ * outside the predicted distribution are rejected like missing ones. A
+ * track that coasted for longer than maxCoast is dropped and restarted by
+ * the next measurement. */
+class RangeTracker {
+ private:
+  RangeTracker(RangeTracker const &) = delete;
+  RangeTracker(RangeTracker &&) = delete;
+  RangeTracker &operator=(RangeTracker const &) = delete;
+  RangeTracker &operator=(RangeTracker &&) = delete;
+
+ public:
+  typedef std::chrono::system_clock::time_point TimePoint;
+
+ public:
+  RangeTracker(float rangeNoise, float accelerationNoise,
+               std::chrono::microseconds maxCoast) noexcept;
+
+ public:
+  bool update(TimePoint time, float distance) noexcept;
+  bool predict(TimePoint time) noexcept;
+  bool isTracking() const noexcept;
+  RangeTrack track() const noexcept;
+
+ private:
+  void propagate(double dt) noexcept;
+
+ private:
+  double m_rangeVariance;
+  double m_accelerationVariance;
+  std::chrono::microseconds m_maxCoast;
+  bool m_tracking;
+  TimePoint m_time;
+  TimePoint m_lastMeasurement;
+  double m_distance;
+  double m_rate; /* Derivative of the distance */
+  double m_p00;
+  double m_p01;
+  double m_p11;
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <cstring>
+
+#include "realtime.hpp"
+
+namespace realtime {
+
+bool setFifoPriority(int32_t priority) noexcept {
+  struct sched_param param;
+  std::memset(&param, 0, sizeof(param));
+  param.sched_priority = priority;
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+bool pinToCpu(int32_t cpu) noexcept {
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return false;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
+bool lockMemory() noexcept {
+  return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+}
+
+void prefaultStack() noexcept {
+  /* Touch the stack the acquisition loop will use, so that it does not take
+   * page faults once it is running. With mlockall the pages then stay. */
+  uint8_t stack[PREFAULT_STACK_SIZE];
+  std::memset(stack, 0, sizeof(stack));
+  /* Keep the compiler from removing the otherwise unused writes. */
+  __asm__ __volatile__("" : : "r"(stack) : "memory");
+}
+
+}  // namespace realtime
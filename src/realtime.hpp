@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALTIME_HPP
+#define REALTIME_HPP
+
+#include <cstdint>
+
+/* Helpers to run the calling thread as a real-time acquisition thread. The
+ * scheduling policy and affinity only apply to the calling thread, so
+ * threads started earlier, like the OD4 receiver, keep their settings. */
+namespace realtime {
+uint32_t const PREFAULT_STACK_SIZE{256 * 1024};
+
+bool setFifoPriority(int32_t priority) noexcept;
+bool pinToCpu(int32_t cpu) noexcept;
+bool lockMemory() noexcept;
+void prefaultStack() noexcept;
+}  // namespace realtime
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "rolling-filter.hpp"
+
+namespace {
+uint32_t const UPPER{0};
+uint32_t const LOWER{1};
+/* Scales the median absolute deviation to the standard deviation of
+ * normally distributed values. */
+float const MAD_SCALE{1.4826f};
+}  // namespace
+
+SlidingMedian::SlidingMedian(uint32_t window)
+    : m_window{std::max(window, 1U)},
+      m_count{0},
+      m_oldest{0},
+      m_values(m_window, 0.0f),
+      m_position(m_window, 0),
+      m_inLower(m_window, false),
+      m_heaps{std::vector<uint32_t>(m_window / 2 + 1, 0),
+              std::vector<uint32_t>(m_window / 2 + 1, 0)},
+      m_sizes{0, 0} {}
+
+void SlidingMedian::push(float value) noexcept {
+  if (m_count < m_window) {
+    /* Filling up: the lower half holds as many values as the upper half,
+     * or one more. */
+    uint32_t const slot{m_count++};
+    m_values[slot] = value;
+    bool const lower{m_sizes[LOWER] == 0 ||
+                     value <= m_values[m_heaps[LOWER][0]]};
+    insert(slot, lower);
+    if (m_sizes[LOWER] > m_sizes[UPPER] + 1) {
+      insert(removeTop(true), false);
+    } else if (m_sizes[UPPER] > m_sizes[LOWER]) {
+      insert(removeTop(false), true);
+    }
+    return;
+  }
+
+  /* Full: the oldest value is overwritten where it sits, which keeps both
+   * halves the same size. Restoring its heap leaves at most the two tops
+   * out of order. */
+  uint32_t const slot{m_oldest};
+  m_oldest = (m_oldest + 1) % m_window;
+  m_values[slot] = value;
+  bool const lower{m_inLower[slot]};
+  siftDown(siftUp(m_position[slot], lower), lower);
+  exchangeTops();
+}
+
+float SlidingMedian::median() const noexcept {
+  if (m_count == 0) {
+    return 0.0f;
+  }
+  float const lower{m_values[m_heaps[LOWER][0]]};
+  if (m_sizes[LOWER] > m_sizes[UPPER]) {
+    return lower;
+  }
+  return (lower + m_values[m_heaps[UPPER][0]]) / 2.0f;
+}
+
+uint32_t SlidingMedian::size() const noexcept { return m_count; }
+
+float const *SlidingMedian::values() const noexcept { return m_values.data(); }
+
+bool SlidingMedian::less(uint32_t a, uint32_t b, bool lower) const noexcept {
+  /* Whether slot a belongs closer to the top of its heap than slot b. */
+  return lower ? m_values[a] > m_values[b] : m_values[a] < m_values[b];
+}
+
+void SlidingMedian::place(uint32_t slot, uint32_t position,
+                          bool lower) noexcept {
+  m_heaps[lower ? LOWER : UPPER][position] = slot;
+  m_position[slot] = position;
+  m_inLower[slot] = lower;
+}
+
+uint32_t SlidingMedian::siftUp(uint32_t position, bool lower) noexcept {
+  std::vector<uint32_t> &heap = m_heaps[lower ? LOWER : UPPER];
+  uint32_t const slot{heap[position]};
+  while (position > 0) {
+    uint32_t const parent{(position - 1) / 2};
+    if (!less(slot, heap[parent], lower)) {
+      break;
+    }
+    place(heap[parent], position, lower);
+    position = parent;
+  }
+  place(slot, position, lower);
+  return position;
+}
+
+void SlidingMedian::siftDown(uint32_t position, bool lower) noexcept {
+  std::vector<uint32_t> &heap = m_heaps[lower ? LOWER : UPPER];
+  uint32_t const size{m_sizes[lower ? LOWER : UPPER]};
+  uint32_t const slot{heap[position]};
+  while (2 * position + 1 < size) {
+    uint32_t child{2 * position + 1};
+    if (child + 1 < size && less(heap[child + 1], heap[child], lower)) {
+      child++;
+    }
+    if (!less(heap[child], slot, lower)) {
+      break;
+    }
+    place(heap[child], position, lower);
+    position = child;
+  }
+  place(slot, position, lower);
+}
+
+void SlidingMedian::insert(uint32_t slot, bool lower) noexcept {
+  uint32_t const position{m_sizes[lower ? LOWER : UPPER]++};
+  place(slot, position, lower);
+  siftUp(position, lower);
+}
+
+uint32_t SlidingMedian::removeTop(bool lower) noexcept {
+  std::vector<uint32_t> &heap = m_heaps[lower ? LOWER : UPPER];
+  uint32_t const top{heap[0]};
+  uint32_t const last{--m_sizes[lower ? LOWER : UPPER]};
+  if (last > 0) {
+    place(heap[last], 0, lower);
+    siftDown(0, lower);
+  }
+  return top;
+}
+
+void SlidingMedian::exchangeTops() noexcept {
+  if (m_sizes[UPPER] == 0) {
+    return;
+  }
+  uint32_t const lowerTop{m_heaps[LOWER][0]};
+  uint32_t const upperTop{m_heaps[UPPER][0]};
+  if (m_values[lowerTop] <= m_values[upperTop]) {
+    return;
+  }
+  place(upperTop, 0, true);
+  place(lowerTop, 0, false);
+  siftDown(0, true);
+  siftDown(0, false);
+}
+
+RollingFilter::RollingFilter(Type type, uint32_t window, float threshold)
+    : m_type{type},
+      m_threshold{threshold},
+      m_median{window},
+      m_deviations(std::max(window, 1U), 0.0f) {}
+
+bool RollingFilter::parseType(std::string const &name, Type &type) noexcept {
+  if (name == "median") {
+    type = Type::Median;
+    return true;
+  }
+  if (name == "hampel") {
+    type = Type::Hampel;
+    return true;
+  }
+  return false;
+}
+
+float RollingFilter::filter(float value) noexcept {
+  m_median.push(value);
+  float const median{m_median.median()};
+  if (m_type == Type::Median) {
+    return median;
+  }
+
+  /* The deviations are all relative to the new median, so their median is
+   * selected afresh in linear time for every value. */
+  uint32_t const n{m_median.size()};
+  float const *values{m_median.values()};
+  for (uint32_t i = 0; i < n; i++) {
+    m_deviations[i] = std::fabs(values[i] - median);
+  }
+  std::nth_element(m_deviations.begin(), m_deviations.begin() + n / 2,
+                   m_deviations.begin() + n);
+  float const mad{m_deviations[n / 2]};
+  return (std::fabs(value - median) > m_threshold * MAD_SCALE * mad) ? median
+                                                                     : value;
+}
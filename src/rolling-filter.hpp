@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ROLLING_FILTER_HPP
+#define ROLLING_FILTER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* Median of the last N values. The window is split into a max-heap of the
+ * lower half and a min-heap of the upper half, both holding positions in a
+ * ring of the values. Every new value replaces the oldest one in place, so
+ * a push costs O(log N) and the median is read from the heap tops. All
+ * storage is allocated up front. */
+class SlidingMedian {
+ private:
+  SlidingMedian(SlidingMedian const &) = delete;
+  SlidingMedian(SlidingMedian &&) = delete;
+  SlidingMedian &operator=(SlidingMedian const &) = delete;
+  SlidingMedian &operator=(SlidingMedian &&) = delete;
+
+ public:
+  explicit SlidingMedian(uint32_t window);
+
+ public:
+  void push(float value) noexcept;
+  float median() const noexcept;
+  uint32_t size() const noexcept;
+  float const *values() const noexcept;
+
+ private:
+  bool less(uint32_t a, uint32_t b, bool lower) const noexcept;
+  void place(uint32_t slot, uint32_t position, bool lower) noexcept;
+  uint32_t siftUp(uint32_t position, bool lower) noexcept;
+  void siftDown(uint32_t position, bool lower) noexcept;
+  void insert(uint32_t slot, bool lower) noexcept;
+  uint32_t removeTop(bool lower) noexcept;
+  void exchangeTops() noexcept;
+
+ private:
+  uint32_t m_window;
+  uint32_t m_count;
+  uint32_t m_oldest;
+  std::vector<float> m_values;
+  std::vector<uint32_t> m_position; /* Heap position of each value */
+  std::vector<bool> m_inLower;
+  std::vector<uint32_t> m_heaps[2]; /* 0: upper min-heap, 1: lower max-heap */
+  uint32_t m_sizes[2];
+};
+
+/* Outlier rejection on a stream of distances. Median replaces every value
+ * by the median of the last N values. Hampel keeps a value unless it lies
+ * more than threshold scaled median absolute deviations from that median,
+ * and replaces it by the median otherwise. */
+class RollingFilter {
+ private:
+  RollingFilter(RollingFilter const &) = delete;
+  RollingFilter(RollingFilter &&) = delete;
+  RollingFilter &operator=(RollingFilter const &) = delete;
+  RollingFilter &operator=(RollingFilter &&) = delete;
+
+ public:
+  enum class Type { Median, Hampel };
+
+ public:
+  RollingFilter(Type type, uint32_t window, float threshold);
+
+ public:
+  static bool parseType(std::string const &name, Type &type) noexcept;
+  float filter(float value) noexcept;
+
+ private:
+  Type m_type;
+  float m_threshold;
+  SlidingMedian m_median;
+  std::vector<float> m_deviations;
+};
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "simulated-srf08.hpp"
+
+namespace {
+float const RANGE_STEP{0.043f}; /* m per range register step */
+}  // namespace
+
+uint8_t const SimulatedSrf08::REVISION;
+uint8_t const SimulatedSrf08::MAX_TARGETS;
+uint8_t const SimulatedSrf08::REGISTER_COUNT;
+
+SimulatedSrf08::SimulatedSrf08(uint8_t address) noexcept
+    : m_address{address},
+      m_registers{},
+      m_pointer{0},
+      m_gain{31},
+      m_range{255},
+      m_targets{},
+      m_targetCount{0},
+      m_speedOfSound{srf08::SPEED_OF_SOUND},
+      m_nackWhileRanging{true},
+      m_rangeWriteNacks{0},
+      m_pings{0},
+      m_rangingUntil{} {
+  m_registers[srf08::COMMAND_REGISTER] = REVISION;
+}
+
+uint8_t SimulatedSrf08::address() const noexcept { return m_address; }
+
+uint8_t SimulatedSrf08::gain() const noexcept { return m_gain; }
+
+uint8_t SimulatedSrf08::range() const noexcept { return m_range; }
+
+uint32_t SimulatedSrf08::pings() const noexcept { return m_pings; }
+
+std::chrono::microseconds SimulatedSrf08::rangingTime() const noexcept {
+  float const window{(static_cast<float>(m_range) + 1.0f) * RANGE_STEP};
+  return std::chrono::microseconds{
+      static_cast<int64_t>(2.0f * window / srf08::SPEED_OF_SOUND * 1e6f)};
+}
+
+bool SimulatedSrf08::isRanging(TimePoint now) const noexcept {
+  return now < m_rangingUntil;
+}
+
+void SimulatedSrf08::setTargets(std::vector<float> const &distances) noexcept {
+  m_targetCount = 0;
+  for (float const d : distances) {
+    if (m_targetCount < MAX_TARGETS) {
+      m_targets[m_targetCount++] = d;
+    }
+  }
+  std::sort(m_targets, m_targets + m_targetCount);
+}
+
+void SimulatedSrf08::setLight(uint8_t light) noexcept {
+  m_registers[srf08::GAIN_REGISTER] = light;
+}
+
+void SimulatedSrf08::setSpeedOfSound(float speedOfSound) noexcept {
+  m_speedOfSound = speedOfSound;
+}
+
+void SimulatedSrf08::setNackWhileRanging(bool nack) noexcept {
+  m_nackWhileRanging = nack;
+}
+
+void SimulatedSrf08::nackRangeWrites(uint32_t count) noexcept {
+  m_rangeWriteNacks = count;
+}
+
+bool SimulatedSrf08::write(uint8_t const *data, uint32_t length,
+                           TimePoint now) noexcept {
+  if (isRanging(now)) {
+    /* Without the NACK the write still goes unheard. */
+    return !m_nackWhileRanging;
+  }
+  if (length == 0) {
+    return false;
+  }
+  if (length > 1 && data[0] == srf08::RANGE_REGISTER &&
+      m_rangeWriteNacks > 0) {
+    m_rangeWriteNacks--;
+    return false;
+  }
+  m_pointer = data[0];
+  for (uint32_t i = 1; i < length; i++, m_pointer++) {
+    if (m_pointer == srf08::COMMAND_REGISTER) {
+      startRanging(data[i], now);
+    } else if (m_pointer == srf08::GAIN_REGISTER) {
+      m_gain = data[i];
+    } else if (m_pointer == srf08::RANGE_REGISTER) {
+      m_range = data[i];
+    }
+  }
+  return true;
+}
+
+bool SimulatedSrf08::read(uint8_t *data, uint32_t length,
+                          TimePoint now) noexcept {
+  if (isRanging(now)) {
+    if (m_nackWhileRanging) {
+      return false;
+    }
+    /* Nobody drives the bus, so the master reads the pulled-up lines. */
+    std::fill(data, data + length, srf08::RANGING_IN_PROGRESS);
+    return true;
+  }
+  for (uint32_t i = 0; i < length; i++, m_pointer++) {
+    data[i] = (m_pointer < REGISTER_COUNT) ? m_registers[m_pointer] : 0;
+  }
+  return true;
+}
+
+void SimulatedSrf08::startRanging(uint8_t command, TimePoint now) noexcept {
+  /* Units per second of round trip time of flight. */
+  float scale{0.0f};
+  if (command == 0x50) {
+    scale = srf08::SPEED_OF_SOUND / 2.0f / 0.0254f; /* Inches */
+  } else if (command == srf08::RANGING_CENTIMETERS) {
+    scale = srf08::SPEED_OF_SOUND / 2.0f * 100.0f;
+  } else if (command == srf08::RANGING_MICROSECONDS) {
+    scale = 1e6f;
+  } else {
+    return;
+  }
+  float const windowTime{(static_cast<float>(m_range) + 1.0f) * RANGE_STEP /
+                         srf08::SPEED_OF_SOUND * 2.0f};
+  std::fill(m_registers + srf08::RANGE_REGISTER,
+            m_registers + REGISTER_COUNT, 0);
+  uint8_t echo{0};
+  for (uint8_t i = 0; i < m_targetCount && echo < srf08::MAX_ECHOES; i++) {
+    float const timeOfFlight{2.0f * m_targets[i] / m_speedOfSound};
+    if (timeOfFlight > windowTime) {
+      break;
+    }
+    uint16_t const value{static_cast<uint16_t>(timeOfFlight * scale + 0.5f)};
+    m_registers[srf08::RANGE_REGISTER + 2 * echo] =
+        static_cast<uint8_t>(value >> 8);
+    m_registers[srf08::RANGE_REGISTER + 2 * echo + 1] =
+        static_cast<uint8_t>(value);
+    echo++;
+  }
+  m_pings++;
+  m_rangingUntil = now + rangingTime();
+}
+
+SimulatedI2cBus::SimulatedI2cBus() noexcept
+    : I2cBus{"simulated"},
+      m_devices{},
+      m_manualClock{false},
+      m_now{},
+      m_transactions{0},
+      m_bytesTransferred{0} {}
+
+SimulatedI2cBus::~SimulatedI2cBus() {}
+
+SimulatedSrf08 &SimulatedI2cBus::add(uint8_t address) {
+  m_devices.emplace_back(new SimulatedSrf08{address});
+  return *m_devices.back();
+}
+
+SimulatedSrf08 *SimulatedI2cBus::device(uint8_t address) noexcept {
+  for (auto &device : m_devices) {
+    if (device->address() == address) {
+      return device.get();
+    }
+  }
+  return nullptr;
+}
+
+void SimulatedI2cBus::useManualClock() noexcept {
+  m_manualClock = true;
+  m_now = std::chrono::steady_clock::now();
+}
+
+void SimulatedI2cBus::advance(std::chrono::microseconds duration) noexcept {
+  m_now += duration;
+}
+
+SimulatedSrf08::TimePoint SimulatedI2cBus::now() const noexcept {
+  return m_manualClock ? m_now : std::chrono::steady_clock::now();
+}
+
+uint64_t SimulatedI2cBus::transactions() const noexcept {
+  return m_transactions;
+}
+
+uint64_t SimulatedI2cBus::bytesTransferred() const noexcept {
+  return m_bytesTransferred;
+}
+
+bool SimulatedI2cBus::isOpen() const noexcept { return true; }
+
+bool SimulatedI2cBus::write(uint8_t address, uint8_t const *data,
+                            uint32_t length) noexcept {
+  m_transactions++;
+  m_bytesTransferred += length;
+  if (address == srf08::GENERAL_CALL_ADDRESS) {
+    /* Acknowledged as long as at least one device listens. */
+    bool acknowledged{false};
+    for (auto &device : m_devices) {
+      acknowledged = device->write(data, length, now()) || acknowledged;
+    }
+    return acknowledged;
+  }
+  SimulatedSrf08 *target{device(address)};
+  return nullptr != target && target->write(data, length, now());
+}
+
+bool SimulatedI2cBus::read(uint8_t address, uint8_t *data,
+                           uint32_t length) noexcept {
+  m_transactions++;
+  m_bytesTransferred += length;
+  SimulatedSrf08 *target{device(address)};
+  return nullptr != target && target->read(data, length, now());
+}
+
+bool SimulatedI2cBus::readRegisters(I2cRegisterRead const *reads,
+                                    uint32_t count) noexcept {
+  /* Like I2C_RDWR, all reads form one transaction that fails as a whole. */
+  m_transactions++;
+  bool ok{true};
+  for (uint32_t i = 0; i < count && ok; i++) {
+    m_bytesTransferred += 1U + reads[i].length;
+    SimulatedSrf08 *target{device(reads[i].address)};
+    ok = nullptr != target && target->write(&reads[i].reg, 1, now()) &&
+         target->read(reads[i].data, reads[i].length, now());
+  }
+  return ok;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIMULATED_SRF08_HPP
+#define SIMULATED_SRF08_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "i2c-bus.hpp"
+#include "srf08.hpp"
+
+/* In-process model of an SRF08 for tests and benchmarks. It implements the
+ * command, gain, range and echo registers, a ranging time that follows the
+ * range register (the time sound needs to travel to the end of the range
+ * window and back), and the way the device ignores the bus while ranging.
+ * A number of writes to the range register can be made to fail as well.
+ * Like the real sensor, it converts times of flight to inches and
+ * centimeters with a fixed speed of sound, whatever the air around it. */
+class SimulatedSrf08 {
+ public:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+  static uint8_t const REVISION{10};
+  static uint8_t const MAX_TARGETS{32};
+
+ public:
+  explicit SimulatedSrf08(uint8_t address) noexcept;
+
+ public:
+  uint8_t address() const noexcept;
+  uint8_t gain() const noexcept;
+  uint8_t range() const noexcept;
+  uint32_t pings() const noexcept;
+  std::chrono::microseconds rangingTime() const noexcept;
+  bool isRanging(TimePoint now) const noexcept;
+  void setTargets(std::vector<float> const &distances) noexcept;
+  void setLight(uint8_t light) noexcept;
+  void setSpeedOfSound(float speedOfSound) noexcept;
+  void setNackWhileRanging(bool nack) noexcept;
+  void nackRangeWrites(uint32_t count) noexcept;
+
+  bool write(uint8_t const *data, uint32_t length, TimePoint now) noexcept;
+  bool read(uint8_t *data, uint32_t length, TimePoint now) noexcept;
+
+ private:
+  void startRanging(uint8_t command, TimePoint now) noexcept;
+
+ private:
+  static uint8_t const REGISTER_COUNT{2 + 2 * srf08::MAX_ECHOES};
+
+  uint8_t m_address;
+  uint8_t m_registers[REGISTER_COUNT];
+  uint8_t m_pointer;
+  uint8_t m_gain;
+  uint8_t m_range;
+  float m_targets[MAX_TARGETS];
+  uint8_t m_targetCount;
+  float m_speedOfSound;
+  bool m_nackWhileRanging;
+  uint32_t m_rangeWriteNacks;
+  uint32_t m_pings;
+  TimePoint m_rangingUntil;
+};
+
+/* I2C bus hosting simulated SRF08 devices. Time either follows the steady
+ * clock or, after useManualClock(), only moves with advance(), so tests can
+ * step through ranging deterministically. A transfer fails like a NACK when
+ * the addressed device is missing or busy ranging. Writes to the general
+ * call address reach every device. */
+class SimulatedI2cBus : public I2cBus {
+ private:
+  SimulatedI2cBus(SimulatedI2cBus const &) = delete;
+  SimulatedI2cBus(SimulatedI2cBus &&) = delete;
+  SimulatedI2cBus &operator=(SimulatedI2cBus const &) = delete;
+  SimulatedI2cBus &operator=(SimulatedI2cBus &&) = delete;
+
+ public:
+  SimulatedI2cBus() noexcept;
+  ~SimulatedI2cBus() override;
+
+ public:
+  SimulatedSrf08 &add(uint8_t address);
+  SimulatedSrf08 *device(uint8_t address) noexcept;
+  void useManualClock() noexcept;
+  void advance(std::chrono::microseconds duration) noexcept;
+  SimulatedSrf08::TimePoint now() const noexcept;
+  uint64_t transactions() const noexcept;
+  uint64_t bytesTransferred() const noexcept;
+
+  using I2cBus::readRegisters;
+  bool isOpen() const noexcept override;
+  bool write(uint8_t address, uint8_t const *data,
+             uint32_t length) noexcept override;
+  bool read(uint8_t address, uint8_t *data, uint32_t length) noexcept override;
+  bool readRegisters(I2cRegisterRead const *reads,
+                     uint32_t count) noexcept override;
+
+ private:
+  std::vector<std::unique_ptr<SimulatedSrf08>> m_devices;
+  bool m_manualClock;
+  SimulatedSrf08::TimePoint m_now;
+  uint64_t m_transactions;
+  uint64_t m_bytesTransferred;
+};
+
+#endif
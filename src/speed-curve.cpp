@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+
+#include "speed-curve.hpp"
+
+SpeedCurve::SpeedCurve() noexcept : m_points{} {}
+
+bool SpeedCurve::parse(std::string const &points) {
+  /* speed:rate:window,speed:rate:window,... */
+  std::vector<Point> parsed;
+  std::istringstream list{points};
+  std::string token;
+  while (std::getline(list, token, ',')) {
+    Point point;
+    char separators[2]{0, 0};
+    std::istringstream fields{token};
+    if (!(fields >> point.speed >> separators[0] >> point.rate >>
+          separators[1] >> point.window) ||
+        separators[0] != ':' || separators[1] != ':' || !fields.eof() ||
+        point.rate <= 0.0f || point.window <= 0.0f ||
+        (!parsed.empty() && point.speed <= parsed.back().speed)) {
+      return false;
+    }
+    parsed.push_back(point);
+  }
+  if (parsed.empty()) {
+    return false;
+  }
+  m_points.swap(parsed);
+  return true;
+}
+
+bool SpeedCurve::empty() const noexcept { return m_points.empty(); }
+
+float SpeedCurve::rate(float speed) const noexcept {
+  return interpolate(speed).rate;
+}
+
+float SpeedCurve::window(float speed) const noexcept {
+  return interpolate(speed).window;
+}
+
+SpeedCurve::Point SpeedCurve::interpolate(float speed) const noexcept {
+  /* Reversing needs the same coverage as driving forward. */
+  speed = std::fabs(speed);
+  if (m_points.empty()) {
+    return Point{};
+  }
+  if (speed <= m_points.front().speed) {
+    return m_points.front();
+  }
+  for (uint32_t i = 1; i < m_points.size(); i++) {
+    Point const &upper = m_points[i];
+    if (speed < upper.speed) {
+      Point const &lower = m_points[i - 1];
+      float const t{(speed - lower.speed) / (upper.speed - lower.speed)};
+      Point point;
+      point.speed = speed;
+      point.rate = lower.rate + t * (upper.rate - lower.rate);
+      point.window = lower.window + t * (upper.window - lower.window);
+      return point;
+    }
+  }
+  return m_points.back();
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPEED_CURVE_HPP
+#define SPEED_CURVE_HPP
+
+#include <string>
+#include <vector>
+
+/* Acquisition rate and range window as a function of the ground speed,
+ * interpolated linearly between points given in order of increasing speed
+ * and held constant beyond the first and the last one. */
+class SpeedCurve {
+ private:
+  SpeedCurve(SpeedCurve const &) = delete;
+  SpeedCurve(SpeedCurve &&) = delete;
+  SpeedCurve &operator=(SpeedCurve const &) = delete;
+  SpeedCurve &operator=(SpeedCurve &&) = delete;
+
+ public:
+  struct Point {
+    float speed{0.0f};  /* m/s */
+    float rate{0.0f};   /* Hz */
+    float window{0.0f}; /* m */
+  };
+
+ public:
+  SpeedCurve() noexcept;
+
+ public:
+  bool parse(std::string const &points);
+  bool empty() const noexcept;
+  float rate(float speed) const noexcept;
+  float window(float speed) const noexcept;
+
+ private:
+  Point interpolate(float speed) const noexcept;
+
+ private:
+  std::vector<Point> m_points;
+};
+
+#endif
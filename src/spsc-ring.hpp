@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/* Lock-free bounded queue from one producer thread to one consumer thread.
+ * Both sides only ever touch their own index and read the other one, so
+ * push() and pop() never wait. When the ring is full, push() fails and the
+ * value is left to the caller. CAPACITY must be a power of two. */
+template <typename T, uint32_t CAPACITY>
+class SpscRing {
+ private:
+  SpscRing(SpscRing const &) = delete;
+  SpscRing(SpscRing &&) = delete;
+  SpscRing &operator=(SpscRing const &) = delete;
+  SpscRing &operator=(SpscRing &&) = delete;
+
+  static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+                "The capacity of an SpscRing must be a power of two.");
+
+ public:
+  SpscRing() noexcept : m_slots{}, m_head{0}, m_padding{}, m_tail{0} {}
+
+ public:
+  bool push(T const &value) noexcept {
+    uint32_t const tail{m_tail.load(std::memory_order_relaxed)};
+    if (tail - m_head.load(std::memory_order_acquire) == CAPACITY) {
+      return false;
+    }
+    m_slots[tail & (CAPACITY - 1)] = value;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &value) noexcept {
+    uint32_t const head{m_head.load(std::memory_order_relaxed)};
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = m_slots[head & (CAPACITY - 1)];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const noexcept {
+    return m_tail.load(std::memory_order_acquire) -
+           m_head.load(std::memory_order_acquire);
+  }
+
+ private:
+  static uint32_t const CACHE_LINE_SIZE{64};
+
+  T m_slots[CAPACITY];
+  std::atomic<uint32_t> m_head; /* Written by the consumer only */
+  /* Keeps the two indices on separate cache lines. */
+  uint8_t m_padding[CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+  std::atomic<uint32_t> m_tail; /* Written by the producer only */
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "srf08-array.hpp"
+
+Srf08Array::Srf08Array(I2cBus &bus) noexcept
+    : m_bus(bus), m_sensors{}, m_states{}, m_slotMasks{}, m_dividers{},
+      m_turns{}, m_fireTimes{},
+      m_echoReads{}, m_echoes{} {}
+
+I2cBus &Srf08Array::bus() noexcept { return m_bus; }
+
+Srf08 &Srf08Array::add(Srf08Config const &config) {
+  m_sensors.emplace_back(new Srf08{m_bus, config});
+  m_states.push_back(State::Idle);
+  m_slotMasks.push_back(0xFFFFFFFF);
+  m_dividers.push_back(1);
+  m_turns.push_back(0);
+  m_fireTimes.emplace_back();
+  m_echoReads.reserve(m_sensors.size());
+  return *m_sensors.back();
+}
+
+std::vector<std::unique_ptr<Srf08>> &Srf08Array::sensors() noexcept {
+  return m_sensors;
+}
+
+Srf08Array::State Srf08Array::state(uint32_t index) const noexcept {
+  return m_states[index];
+}
+
+void Srf08Array::setSlotMask(uint32_t index, uint32_t slotMask) noexcept {
+  m_slotMasks[index] = slotMask;
+}
+
+void Srf08Array::setDivider(uint32_t index, uint32_t divider) noexcept {
+  m_dividers[index] = (divider > 0) ? divider : 1;
+  if (m_turns[index] >= m_dividers[index]) {
+    m_turns[index] = m_dividers[index] - 1;
+  }
+}
+
+uint32_t Srf08Array::fire() noexcept { return fireMatching(0xFFFFFFFF); }
+
+uint32_t Srf08Array::fire(uint32_t slot) noexcept {
+  return fireMatching(1U << slot);
+}
+
+uint32_t Srf08Array::fireMatching(uint32_t slotMask) noexcept {
+  /* All idle sensors in the given slots are fired back to back and share one
+   * ranging period. Sensors that have not been collected yet are left
+   * alone. */
+  uint32_t failures{0};
+  for (uint32_t i = 0; i < m_sensors.size(); i++) {
+    if (m_states[i] != State::Idle || (m_slotMasks[i] & slotMask) == 0) {
+      continue;
+    }
+    if (m_turns[i] > 0) {
+      m_turns[i]--;
+      continue;
+    }
+    m_turns[i] = m_dividers[i] - 1;
+    if (m_sensors[i]->startRanging()) {
+      m_states[i] = State::Ranging;
+      m_fireTimes[i] = std::chrono::system_clock::now();
+    } else {
+      std::cerr << "Could not write ranging request to device "
+                << static_cast<int32_t>(m_sensors[i]->address()) << "."
+                << std::endl;
+      failures++;
+    }
+  }
+  return failures;
+}
+
+uint32_t Srf08Array::fireBroadcast() noexcept {
+  /* One general call write fires every sensor, so all of them share one
+   * fire time, whatever their slot masks and dividers. Sensors still
+   * ranging ignore the write and stay pending. */
+  uint32_t idle{0};
+  for (auto const state : m_states) {
+    idle += (state == State::Idle) ? 1 : 0;
+  }
+  if (idle == 0) {
+    return 0;
+  }
+  if (!Srf08::startRangingBroadcast(m_bus,
+                                    m_sensors[0]->rangingCommand())) {
+    std::cerr << "Could not write broadcast ranging request to "
+              << m_bus.devNode() << "." << std::endl;
+    return idle;
+  }
+  auto const fireTime{std::chrono::system_clock::now()};
+  for (uint32_t i = 0; i < m_sensors.size(); i++) {
+    if (m_states[i] == State::Idle) {
+      m_states[i] = State::Ranging;
+      m_fireTimes[i] = fireTime;
+    }
+  }
+  return 0;
+}
+
+uint32_t Srf08Array::waitForRanging(
+    std::chrono::duration<double, std::milli> interval,
+    std::chrono::duration<double, std::milli> timeout) noexcept {
+  /* Poll until every sensor answers on the bus again, so that the cycle
+   * lasts as long as the configured range window requires. */
+  auto const deadline{std::chrono::steady_clock::now() + timeout};
+  uint32_t pending{0};
+  while (true) {
+    pending = 0;
+    for (uint32_t i = 0; i < m_sensors.size(); i++) {
+      if (m_states[i] == State::Ranging) {
+        if (m_sensors[i]->isRangingComplete()) {
+          m_states[i] = State::Ready;
+        } else {
+          pending++;
+        }
+      }
+    }
+    if (pending == 0 || std::chrono::steady_clock::now() >= deadline) {
+      break;
+    }
+    std::this_thread::sleep_for(interval);
+  }
+  return pending;
+}
+
+void Srf08Array::markReady() noexcept {
+  for (auto &state : m_states) {
+    if (state == State::Ranging) {
+      state = State::Ready;
+    }
+  }
+}
+
+std::chrono::microseconds Srf08Array::rangingTime() const noexcept {
+  std::chrono::microseconds longest{0};
+  for (auto const &sensor : m_sensors) {
+    longest = std::max(longest, sensor->rangingTime());
+  }
+  return longest;
+}
+
+uint32_t Srf08Array::collect(
+    std::function<void(Srf08 &, Srf08Echoes const &)> const
+        &delegate) noexcept {
+  /* The echo registers of all ready sensors are read in one combined
+   * transaction. If any device fails to answer, each one is read on its
+   * own to find out which. */
+  m_echoReads.clear();
+  for (uint32_t i = 0; i < m_sensors.size(); i++) {
+    if (m_states[i] == State::Ready) {
+      m_echoReads.push_back(m_sensors[i]->echoRead());
+    }
+  }
+  if (m_echoReads.empty()) {
+    return 0;
+  }
+  bool const batchRead{m_bus.readRegisters(
+      m_echoReads.data(), static_cast<uint32_t>(m_echoReads.size()))};
+
+  uint32_t failures{0};
+  for (uint32_t i = 0; i < m_sensors.size(); i++) {
+    if (m_states[i] != State::Ready) {
+      continue;
+    }
+    m_states[i] = State::Idle;
+    auto &sensor = m_sensors[i];
+    m_echoes.fireTime = m_fireTimes[i];
+    if (batchRead) {
+      sensor->decodedEchoes(m_echoes);
+    } else if (!sensor->readEchoes(m_echoes)) {
+      std::cerr << "Could not read data from device "
+                << static_cast<int32_t>(sensor->address()) << "."
+                << std::endl;
+      failures++;
+      continue;
+    }
+    if (nullptr != delegate) {
+      delegate(*sensor, m_echoes);
+    }
+  }
+  return failures;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRF08_ARRAY_HPP
+#define SRF08_ARRAY_HPP
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "i2c-bus.hpp"
+#include "srf08.hpp"
+
+/* All SRF08 sensors on one bus. Every sensor moves through the states idle,
+ * ranging and ready, so that firing and collecting can either follow each
+ * other in one cycle or be split over consecutive cycles. Each sensor
+ * belongs to a set of firing slots, given as a bit mask, and by default to
+ * all of them. A divider of N fires a sensor only on every Nth turn of its
+ * slots, which lowers its rate without touching the schedule. */
+class Srf08Array {
+ private:
+  Srf08Array(Srf08Array const &) = delete;
+  Srf08Array(Srf08Array &&) = delete;
+  Srf08Array &operator=(Srf08Array const &) = delete;
+  Srf08Array &operator=(Srf08Array &&) = delete;
+
+ public:
+  enum class State { Idle, Ranging, Ready };
+
+ public:
+  explicit Srf08Array(I2cBus &bus) noexcept;
+
+ public:
+  I2cBus &bus() noexcept;
+  Srf08 &add(Srf08Config const &config);
+  std::vector<std::unique_ptr<Srf08>> &sensors() noexcept;
+  State state(uint32_t index) const noexcept;
+  void setSlotMask(uint32_t index, uint32_t slotMask) noexcept;
+  void setDivider(uint32_t index, uint32_t divider) noexcept;
+
+  uint32_t fire() noexcept;
+  uint32_t fire(uint32_t slot) noexcept;
+  uint32_t fireBroadcast() noexcept;
+  uint32_t waitForRanging(std::chrono::duration<double, std::milli> interval,
+                          std::chrono::duration<double, std::milli>
+                              timeout) noexcept;
+  void markReady() noexcept;
+  std::chrono::microseconds rangingTime() const noexcept;
+  uint32_t collect(std::function<void(Srf08 &, Srf08Echoes const &)> const
+                       &delegate) noexcept;
+
+ private:
+  uint32_t fireMatching(uint32_t slotMask) noexcept;
+
+ private:
+  I2cBus &m_bus;
+  std::vector<std::unique_ptr<Srf08>> m_sensors;
+  std::vector<State> m_states;
+  std::vector<uint32_t> m_slotMasks;
+  std::vector<uint32_t> m_dividers;
+  std::vector<uint32_t> m_turns; /* Turns left until the next firing */
+  std::vector<std::chrono::system_clock::time_point> m_fireTimes;
+  std::vector<I2cRegisterRead> m_echoReads;
+  Srf08Echoes m_echoes;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "srf08.hpp"
+
+float srf08::speedOfSound(float temperature) noexcept {
+  /* Dry air, with the temperature in degrees Celsius. */
+  return 331.3f * std::sqrt(1.0f + temperature / 273.15f);
+}
+
+Srf08::Srf08(I2cBus &bus, Srf08Config const &config) noexcept
+    : m_bus(bus),
+      m_config(config),
+      m_speedOfSound{srf08::SPEED_OF_SOUND},
+      m_echoBuffer{} {}
+
+uint8_t Srf08::address() const noexcept { return m_config.address; }
+
+uint32_t Srf08::id() const noexcept { return m_config.id; }
+
+uint8_t Srf08::rangingCommand() const noexcept {
+  return m_config.microseconds ? srf08::RANGING_MICROSECONDS
+                               : srf08::RANGING_CENTIMETERS;
+}
+
+uint8_t Srf08::range() const noexcept { return m_config.range; }
+
+uint8_t Srf08::gain() const noexcept { return m_config.gain; }
+
+std::chrono::microseconds Srf08::rangingTime() const noexcept {
+  /* The listening time is set by the range register, 65 ms in 256 steps,
+   * whatever the speed of sound. */
+  return std::chrono::microseconds{
+      (static_cast<int64_t>(m_config.range) + 1) * 65000 / 256};
+}
+
+void Srf08::setSpeedOfSound(float speedOfSound) noexcept {
+  m_speedOfSound.store(speedOfSound, std::memory_order_relaxed);
+}
+
+bool Srf08::readFirmware(uint8_t &version) noexcept {
+  return m_bus.readRegisters(m_config.address, srf08::COMMAND_REGISTER,
+                             &version, 1);
+}
+
+bool Srf08::writeRange(uint8_t range) noexcept {
+  /* Reducing echo listening time, and thus range to 43mm * range -
+   * max/default is 65ms which is approx. 11m */
+  uint8_t const buf[2]{srf08::RANGE_REGISTER, range};
+  if (!m_bus.write(m_config.address, buf, 2)) {
+    return false;
+  }
+  m_config.range = range;
+  return true;
+}
+
+bool Srf08::writeGain(uint8_t gain) noexcept {
+  /*Reducing rate of echos fired by sensor to lower/higher than default value
+  of 65ms
+  This can lead to false readings if echos from previous pings are too fast */
+  uint8_t const buf[2]{srf08::GAIN_REGISTER, gain};
+  if (!m_bus.write(m_config.address, buf, 2)) {
+    return false;
+  }
+  m_config.gain = gain;
+  return true;
+}
+
+bool Srf08::startRanging() noexcept {
+  /* By writing 0x51 to the Command Register, the Ranging Mode will be in
+   * centimeters, and with 0x52 in microseconds */
+  uint8_t const commandBuffer[2]{srf08::COMMAND_REGISTER, rangingCommand()};
+  return m_bus.write(m_config.address, commandBuffer, 2);
+}
+
+bool Srf08::startRangingBroadcast(I2cBus &bus, uint8_t command) noexcept {
+  /* The SRF08 also listens to the general call address, so one write starts
+   * ranging on every sensor of the bus at the same instant. */
+  uint8_t const commandBuffer[2]{srf08::COMMAND_REGISTER, command};
+  return bus.write(srf08::GENERAL_CALL_ADDRESS, commandBuffer, 2);
+}
+
+std::chrono::system_clock::time_point Srf08::reflectionTime(
+    std::chrono::system_clock::time_point fireTime, float distance,
+    float speedOfSound) noexcept {
+  /* The object was measured when the ping reached it, which is half the
+   * time of flight of its echo after the ping was fired. */
+  return fireTime + std::chrono::microseconds{static_cast<int64_t>(
+                        distance / speedOfSound * 1e6f + 0.5f)};
+}
+
+bool Srf08::isRangingComplete() noexcept {
+  /* The SRF08 does not acknowledge its address while ranging, and reads back
+   * 0xFF from the software revision register until the echoes are stored. */
+  uint8_t revision{srf08::RANGING_IN_PROGRESS};
+  return readFirmware(revision) && revision != srf08::RANGING_IN_PROGRESS;
+}
+
+bool Srf08::readEchoes(Srf08Echoes &echoes) noexcept {
+  I2cRegisterRead const request{echoRead()};
+  if (!m_bus.readRegisters(&request, 1)) {
+    return false;
+  }
+  decodedEchoes(echoes);
+  return true;
+}
+
+I2cRegisterRead Srf08::echoRead() noexcept {
+  /* Read the 1st to Nth Echo High & Low Byte, starting at the Range Register.
+   * Each unused echo pair would cost two bytes of bus time per sample. The
+   * light sensor sits right before it and costs a single byte. */
+  I2cRegisterRead request;
+  request.address = m_config.address;
+  request.reg = m_config.light ? srf08::LIGHT_REGISTER : srf08::RANGE_REGISTER;
+  request.data = m_echoBuffer;
+  request.length =
+      static_cast<uint16_t>(2 * m_config.echoes + (m_config.light ? 1 : 0));
+  return request;
+}
+
+void Srf08::decodedEchoes(Srf08Echoes &echoes) const noexcept {
+  /* A time of flight covers the distance twice, and the sensor's own
+   * conversion to centimeters assumes a fixed speed of sound. */
+  float const speedOfSound{m_speedOfSound.load(std::memory_order_relaxed)};
+  echoes.speedOfSound =
+      m_config.microseconds ? speedOfSound : srf08::SPEED_OF_SOUND;
+  echoes.range = m_config.range;
+  echoes.hasLight = m_config.light;
+  echoes.light = m_config.light ? m_echoBuffer[0] : 0;
+  decodeEchoes(m_echoBuffer + (m_config.light ? 1 : 0), 2U * m_config.echoes,
+               m_config.microseconds ? speedOfSound / 2e6f : 0.01f, echoes);
+}
+
+void Srf08::decodeEchoes(uint8_t const *buffer, uint32_t length,
+                         float metersPerUnit, Srf08Echoes &echoes) noexcept {
+  echoes.count = 0;
+  for (uint32_t i = 0; i + 1 < length && echoes.count < srf08::MAX_ECHOES;
+       i += 2) {
+    /* One result from a ranging request is a 16 bit unsigned integer, high
+    byte first A value of zero means no objects were detected */
+    if (buffer[i] == 0 && buffer[i + 1] == 0) {
+      break;
+    }
+    uint16_t const range =
+        static_cast<uint16_t>((buffer[i] << 8) | buffer[i + 1]);
+    echoes.distances[echoes.count++] =
+        static_cast<float>(range) *
+        metersPerUnit; /* Convert result in centimeters or us to meters */
+  }
+}
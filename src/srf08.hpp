@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRF08_HPP
+#define SRF08_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "i2c-bus.hpp"
+
+namespace srf08 {
+uint8_t const GENERAL_CALL_ADDRESS{0x00}; /* Every SRF08 on the bus */
+uint8_t const COMMAND_REGISTER{0x00};   /* Write: command, read: revision */
+uint8_t const GAIN_REGISTER{0x01};      /* Write: max gain, read: light */
+uint8_t const LIGHT_REGISTER{0x01};
+uint8_t const RANGE_REGISTER{0x02};     /* Write: range, read: 1st echo */
+uint8_t const RANGING_CENTIMETERS{0x51};
+uint8_t const RANGING_MICROSECONDS{0x52}; /* Round trip time of flight */
+uint8_t const RANGING_IN_PROGRESS{0xFF}; /* Revision read while ranging */
+uint8_t const MAX_ECHOES{17};
+uint8_t const MAX_GAIN{31};            /* Highest analogue gain setting */
+uint8_t const MAX_SENSORS_PER_BUS{16}; /* Addresses 0xE0 to 0xFE */
+float const LIGHT_FULL_SCALE{248.0f};  /* Light reading in bright daylight */
+float const SPEED_OF_SOUND{343.2f};    /* m/s in dry air at 20 degrees C */
+
+float speedOfSound(float temperature) noexcept;
+}  // namespace srf08
+
+/* Fixed-capacity storage for the decoded echoes of one ping, in meters,
+ * the time at which the ping was requested, the speed of sound used to
+ * convert them and the range register that set its window. The light
+ * level, taken with the ping, is only valid when it was read along with
+ * the echoes. */
+struct Srf08Echoes {
+  float distances[srf08::MAX_ECHOES]{};
+  uint8_t count{0};
+  bool hasLight{false};
+  uint8_t light{0};
+  std::chrono::system_clock::time_point fireTime{};
+  float speedOfSound{srf08::SPEED_OF_SOUND};
+  uint8_t range{255};
+};
+
+struct Srf08Config {
+  uint8_t address{0};
+  uint32_t id{0};
+  uint8_t range{255};
+  uint8_t gain{31};
+  uint8_t echoes{1}; /* Number of echoes to read, 1 to MAX_ECHOES */
+  bool microseconds{false}; /* Range in time of flight, not centimeters */
+  bool light{false};        /* Read the light sensor with the echoes */
+};
+
+class Srf08 {
+ private:
+  Srf08(Srf08 const &) = delete;
+  Srf08(Srf08 &&) = delete;
+  Srf08 &operator=(Srf08 const &) = delete;
+  Srf08 &operator=(Srf08 &&) = delete;
+
+ public:
+  Srf08(I2cBus &bus, Srf08Config const &config) noexcept;
+
+ public:
+  uint8_t address() const noexcept;
+  uint32_t id() const noexcept;
+  uint8_t rangingCommand() const noexcept;
+  uint8_t range() const noexcept;
+  uint8_t gain() const noexcept;
+  std::chrono::microseconds rangingTime() const noexcept;
+  void setSpeedOfSound(float speedOfSound) noexcept;
+  bool readFirmware(uint8_t &version) noexcept;
+  bool writeRange(uint8_t range) noexcept;
+  bool writeGain(uint8_t gain) noexcept;
+  bool startRanging() noexcept;
+  bool isRangingComplete() noexcept;
+  bool readEchoes(Srf08Echoes &echoes) noexcept;
+  I2cRegisterRead echoRead() noexcept;
+  void decodedEchoes(Srf08Echoes &echoes) const noexcept;
+
+ public:
+  static bool startRangingBroadcast(I2cBus &bus, uint8_t command) noexcept;
+  static std::chrono::system_clock::time_point reflectionTime(
+      std::chrono::system_clock::time_point fireTime, float distance,
+      float speedOfSound) noexcept;
+  static void decodeEchoes(uint8_t const *buffer, uint32_t length,
+                           float metersPerUnit, Srf08Echoes &echoes) noexcept;
+
+ private:
+  I2cBus &m_bus;
+  Srf08Config m_config;
+  std::atomic<float> m_speedOfSound; /* Set from other threads */
+  uint8_t m_echoBuffer[1 + 2 * srf08::MAX_ECHOES]; /* Array of bytes, need
+                                                      to store the light and
+                                                      17 pairs of Echo High &
+                                                      Low Bytes */
+};
+
+#endif
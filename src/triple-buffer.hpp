@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020 Björnborg Nguyen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+/* Lock-free handoff of the latest value from one writer thread to one reader
+ * thread. The writer fills back() and publishes it; the reader picks up the
+ * most recently published value, if any, with update(). Neither side ever
+ * waits for the other, and intermediate values may be skipped. */
+template <typename T>
+class TripleBuffer {
+ private:
+  TripleBuffer(TripleBuffer const &) = delete;
+  TripleBuffer(TripleBuffer &&) = delete;
+  TripleBuffer &operator=(TripleBuffer const &) = delete;
+  TripleBuffer &operator=(TripleBuffer &&) = delete;
+
+ public:
+  TripleBuffer() noexcept
+      : m_buffers{}, m_back{0}, m_middle{1}, m_front{2} {}
+
+ public:
+  T &back() noexcept { return m_buffers[m_back]; }
+
+  void publish() noexcept {
+    m_back = static_cast<uint8_t>(
+        m_middle.exchange(static_cast<uint8_t>(m_back | FRESH),
+                          std::memory_order_acq_rel) &
+        INDEX);
+  }
+
+  bool update() noexcept {
+    if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+      return false;
+    }
+    m_front = static_cast<uint8_t>(
+        m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX);
+    return true;
+  }
+
+  T const &front() const noexcept { return m_buffers[m_front]; }
+
+ private:
+  static uint8_t const INDEX{0x03};
+  static uint8_t const FRESH{0x04};
+
+  T m_buffers[3];
+  uint8_t m_back;
+  std::atomic<uint8_t> m_middle;
+  uint8_t m_front;
+};
+
+#endif
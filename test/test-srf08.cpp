@@ -15,12 +15,1160 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+// The replaced operator new below is paired with std::free on purpose.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+#define CATCH_CONFIG_NO_POSIX_SIGNALS  // SIGSTKSZ is no longer a constant in recent glibc
 #include "catch.hpp"
 
 #include "cluon-complete.hpp"
+#include "opendlv-device-ultrasonic-srf08-messages.hpp"
 #include "opendlv-standard-message-set.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <sstream>
+
+#include "bus-acquisition.hpp"
+#include "deadline-scheduler.hpp"
+#include "envelope-encoder.hpp"
+#include "firing-schedule.hpp"
+#include "gain-range-controller.hpp"
+#include "od4-publisher.hpp"
+#include "publisher-thread.hpp"
+#include "range-tracker.hpp"
+#include "rolling-filter.hpp"
+#include "speed-curve.hpp"
+#include "simulated-srf08.hpp"
+#include "srf08-array.hpp"
+#include "spsc-ring.hpp"
+#include "srf08.hpp"
+#include "triple-buffer.hpp"
+
+/* Counts every heap allocation of the test runner, to prove that the
+ * acquisition hot path does not allocate once it is warmed up. */
+static std::atomic<uint64_t> g_allocations{0};
+
+void *operator new(std::size_t size) {
+  g_allocations++;
+  void *ptr = std::malloc(size > 0 ? size : 1);
+  if (nullptr == ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
 TEST_CASE("Test SRF08 interface") {
   REQUIRE(true);
 }
+
+TEST_CASE("Test SRF08 echo decoding stops at the first empty echo") {
+  uint8_t const buffer[8]{0x00, 0x64, 0x01, 0x2C, 0x00, 0x00, 0x02, 0x00};
+  Srf08Echoes echoes;
+  Srf08::decodeEchoes(buffer, sizeof(buffer), 0.01f, echoes);
+  REQUIRE(echoes.count == 2);
+  REQUIRE(echoes.distances[0] == Approx(1.0f));
+  REQUIRE(echoes.distances[1] == Approx(3.0f));
+}
+
+TEST_CASE("Test SRF08 echoes are time-stamped at the reflection") {
+  std::chrono::system_clock::time_point const fireTime{
+      std::chrono::seconds{100}};
+  REQUIRE(Srf08::reflectionTime(fireTime, 0.0f, srf08::SPEED_OF_SOUND) ==
+          fireTime);
+  /* 3.432 m away, the ping arrives 10 ms after it was fired. */
+  REQUIRE(Srf08::reflectionTime(fireTime, 3.432f, srf08::SPEED_OF_SOUND) ==
+          fireTime + std::chrono::milliseconds{10});
+}
+
+TEST_CASE("Test SRF08 microsecond ranging compensates for temperature") {
+  REQUIRE(srf08::speedOfSound(20.0f) == Approx(srf08::SPEED_OF_SOUND)
+                                            .epsilon(0.001));
+  REQUIRE(srf08::speedOfSound(-20.0f) == Approx(319.1f).epsilon(0.001));
+
+  /* In cold air the sensor's own conversion overestimates the distance. */
+  SimulatedI2cBus bus;
+  bus.useManualClock();
+  SimulatedSrf08 &device{bus.add(0x70)};
+  device.setTargets({2.0f});
+  device.setSpeedOfSound(srf08::speedOfSound(-20.0f));
+  Srf08Config config{0x70, 0, 255, 31, 1};
+  Srf08 centimeters{bus, config};
+  config.microseconds = true;
+  Srf08 microseconds{bus, config};
+  microseconds.setSpeedOfSound(srf08::speedOfSound(-20.0f));
+
+  Srf08Echoes echoes;
+  REQUIRE(centimeters.startRanging());
+  bus.advance(device.rangingTime());
+  REQUIRE(centimeters.readEchoes(echoes));
+  REQUIRE(echoes.distances[0] > 2.1f);
+
+  REQUIRE(microseconds.startRanging());
+  bus.advance(device.rangingTime());
+  REQUIRE(microseconds.readEchoes(echoes));
+  REQUIRE(echoes.distances[0] == Approx(2.0f).epsilon(0.001));
+  REQUIRE(echoes.speedOfSound == Approx(319.1f).epsilon(0.001));
+}
+
+TEST_CASE("Test SRF08 reads the light sensor along with the echoes") {
+  SimulatedI2cBus bus;
+  bus.useManualClock();
+  SimulatedSrf08 &device{bus.add(0x70)};
+  device.setTargets({0.8f, 1.6f});
+  device.setLight(124);
+  Srf08Config config{0x70, 0, 255, 31, 2};
+  config.light = true;
+  Srf08 sensor{bus, config};
+  I2cRegisterRead const request{sensor.echoRead()};
+  REQUIRE(request.reg == srf08::LIGHT_REGISTER);
+  REQUIRE(request.length == 5);
+
+  REQUIRE(sensor.startRanging());
+  bus.advance(device.rangingTime());
+  uint64_t const before{bus.transactions()};
+  Srf08Echoes echoes;
+  REQUIRE(sensor.readEchoes(echoes));
+  REQUIRE(bus.transactions() == before + 1);
+  REQUIRE(echoes.hasLight);
+  REQUIRE(echoes.light == 124);
+  REQUIRE(echoes.count == 2);
+  REQUIRE(echoes.distances[0] == Approx(0.8f));
+  REQUIRE(echoes.distances[1] == Approx(1.6f));
+}
+
+TEST_CASE("Test deadline scheduler keeps the period without drift") {
+  DeadlineScheduler scheduler{200.0f, DeadlineScheduler::OverrunPolicy::Skip};
+  uint32_t calls{0};
+  auto const start{std::chrono::steady_clock::now()};
+  scheduler.run([&calls]() { return ++calls < 20; });
+  auto const elapsed{std::chrono::steady_clock::now() - start};
+  REQUIRE(calls == 20);
+  REQUIRE(scheduler.cycles() == 20);
+  REQUIRE(elapsed >= std::chrono::milliseconds(90));
+}
+
+TEST_CASE("Test deadline scheduler skips cycles after an overrun") {
+  DeadlineScheduler scheduler{100.0f, DeadlineScheduler::OverrunPolicy::Skip};
+  uint32_t calls{0};
+  scheduler.run([&calls]() {
+    if (calls == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(35));
+    }
+    return ++calls < 3;
+  });
+  REQUIRE(scheduler.missedDeadlines() >= 1);
+  REQUIRE(scheduler.skippedCycles() >= 3);
+}
+
+TEST_CASE("Test deadline scheduler catches up after an overrun") {
+  DeadlineScheduler scheduler{100.0f,
+                              DeadlineScheduler::OverrunPolicy::CatchUp};
+  uint32_t calls{0};
+  scheduler.run([&calls]() {
+    if (calls == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(35));
+    }
+    return ++calls < 5;
+  });
+  /* The missed cycles are all run instead of skipped. */
+  REQUIRE(calls == 5);
+  REQUIRE(scheduler.cycles() == 5);
+  REQUIRE(scheduler.missedDeadlines() >= 3);
+  REQUIRE(scheduler.skippedCycles() == 0);
+}
+
+TEST_CASE("Test envelope encoder matches cluon serializeEnvelope") {
+  cluon::data::TimeStamp sent;
+  sent.seconds(1590000000).microseconds(123456);
+  cluon::data::TimeStamp sample;
+  sample.seconds(1590000000).microseconds(-5);
+
+  opendlv::proxy::DistanceReading distanceReading;
+  distanceReading.distance(1.23f);
+  cluon::ToProtoVisitor protoEncoder;
+  distanceReading.accept(protoEncoder);
+  cluon::data::Envelope envelope;
+  envelope.dataType(opendlv::proxy::DistanceReading::ID());
+  envelope.serializedData(protoEncoder.encodedData());
+  envelope.sent(sent);
+  envelope.sampleTimeStamp(sample);
+  envelope.senderStamp(1003);
+  std::string const expected{cluon::serializeEnvelope(std::move(envelope))};
+
+  EnvelopeEncoder encoder;
+  encoder.payload(opendlv::proxy::DistanceReading::ID()).writeFloat(1, 1.23f);
+  uint32_t const length{encoder.encode(sent, sample, 1003)};
+  REQUIRE(length == expected.size());
+  REQUIRE(std::string(reinterpret_cast<char const *>(encoder.data()),
+                      length) == expected);
+}
+
+TEST_CASE("Test all echoes of a ping are encoded into one message") {
+  cluon::data::TimeStamp sent;
+  sent.seconds(1590000000).microseconds(123456);
+  Srf08Echoes echoes;
+  echoes.count = srf08::MAX_ECHOES;
+  echoes.range = 140;
+  for (uint8_t i = 0; i < echoes.count; i++) {
+    echoes.distances[i] = 0.25f * static_cast<float>(i + 1);
+  }
+
+  EnvelopeEncoder encoder;
+  uint32_t const length{Od4Publisher::encodeEchoes(encoder, echoes, sent, 7)};
+  REQUIRE(length > 0);
+  std::stringstream stream{
+      std::string(reinterpret_cast<char const *>(encoder.data()), length)};
+  auto envelope{cluon::extractEnvelope(stream)};
+  REQUIRE(envelope.first);
+  REQUIRE(envelope.second.senderStamp() == 7);
+  auto const reading{
+      cluon::extractMessage<opendlv::device::ultrasonic::EchoReading>(
+          std::move(envelope.second))};
+  REQUIRE(reading.count() == srf08::MAX_ECHOES);
+  REQUIRE(reading.distances().size() == 4U * srf08::MAX_ECHOES);
+  REQUIRE(reading.window() == Approx(GainRangeController::rangeWindow(140)));
+  for (uint32_t i = 0; i < reading.count(); i++) {
+    float distance{0.0f};
+    std::memcpy(&distance, reading.distances().data() + 4 * i,
+                sizeof(distance));
+    REQUIRE(distance == Approx(echoes.distances[i]));
+  }
+}
+
+TEST_CASE("Test decoding and encoding a sample does not allocate") {
+  uint8_t buffer[2 * srf08::MAX_ECHOES]{0x00, 0x64, 0x01, 0x2C};
+  Srf08Echoes echoes;
+  EnvelopeEncoder encoder;
+  uint32_t length{0};
+  auto cycle{[&]() {
+    Srf08::decodeEchoes(buffer, sizeof(buffer), 0.01f, echoes);
+    cluon::data::TimeStamp const now{cluon::time::now()};
+    for (uint8_t i = 0; i < echoes.count; i++) {
+      encoder.payload(opendlv::proxy::DistanceReading::ID())
+          .writeFloat(1, echoes.distances[i]);
+      length += encoder.encode(now, now, i);
+    }
+  }};
+  cycle();
+
+  uint64_t const before{g_allocations.load()};
+  for (uint32_t i = 0; i < 1000; i++) {
+    cycle();
+  }
+  REQUIRE(g_allocations.load() == before);
+  REQUIRE(length > 0);
+}
+
+TEST_CASE("Test triple buffer hands over only the latest value") {
+  TripleBuffer<uint32_t> buffer;
+  REQUIRE_FALSE(buffer.update());
+  buffer.back() = 1;
+  buffer.publish();
+  buffer.back() = 2;
+  buffer.publish();
+  REQUIRE(buffer.update());
+  REQUIRE(buffer.front() == 2);
+  REQUIRE_FALSE(buffer.update());
+  buffer.back() = 3;
+  buffer.publish();
+  REQUIRE(buffer.update());
+  REQUIRE(buffer.front() == 3);
+}
+
+TEST_CASE("Test SRF08 array cycle on a simulated bus") {
+  SimulatedI2cBus bus;
+  bus.useManualClock();
+  bus.add(0x70).setTargets({0.5f, 1.25f});
+  bus.add(0x71).setTargets({2.0f});
+  Srf08Array array{bus};
+  array.add(Srf08Config{0x70, 0, 255, 31, 3});
+  array.add(Srf08Config{0x71, 1, 255, 31, 3});
+
+  REQUIRE(array.fire() == 0);
+  REQUIRE(array.waitForRanging(std::chrono::milliseconds{0},
+                               std::chrono::milliseconds{0}) == 2);
+  REQUIRE(array.fire() == 0);
+  bus.advance(bus.device(0x70)->rangingTime());
+  REQUIRE(array.waitForRanging(std::chrono::milliseconds{0},
+                               std::chrono::milliseconds{0}) == 0);
+
+  float distances[2][3]{};
+  uint8_t counts[2]{};
+  REQUIRE(array.collect([&](Srf08 &sensor, Srf08Echoes const &echoes) {
+    counts[sensor.id()] = echoes.count;
+    for (uint8_t i = 0; i < echoes.count; i++) {
+      distances[sensor.id()][i] = echoes.distances[i];
+    }
+  }) == 0);
+  REQUIRE(counts[0] == 2);
+  REQUIRE(distances[0][0] == Approx(0.5f));
+  REQUIRE(distances[0][1] == Approx(1.25f));
+  REQUIRE(counts[1] == 1);
+  REQUIRE(distances[1][0] == Approx(2.0f));
+  REQUIRE(bus.device(0x70)->pings() == 1);
+}
+
+TEST_CASE("Test simulated SRF08 ignores the bus while ranging") {
+  SimulatedI2cBus bus;
+  bus.useManualClock();
+  SimulatedSrf08 &device{bus.add(0x70)};
+  Srf08 sensor{bus, Srf08Config{0x70, 0, 255, 31, 1}};
+  uint8_t revision{0};
+  REQUIRE(sensor.readFirmware(revision));
+  REQUIRE(revision == SimulatedSrf08::REVISION);
+
+  REQUIRE(sensor.startRanging());
+  REQUIRE_FALSE(sensor.readFirmware(revision));
+  REQUIRE_FALSE(sensor.writeGain(10));
+  device.setNackWhileRanging(false);
+  REQUIRE(sensor.readFirmware(revision));
+  REQUIRE(revision == srf08::RANGING_IN_PROGRESS);
+  REQUIRE_FALSE(sensor.isRangingComplete());
+  REQUIRE(sensor.writeGain(10));
+  REQUIRE(device.gain() == 31);
+
+  bus.advance(device.rangingTime());
+  REQUIRE(sensor.isRangingComplete());
+  REQUIRE_FALSE(bus.write(0x7F, &revision, 1));
+}
+
+TEST_CASE("Test simulated SRF08 ranging time follows the range register") {
+  SimulatedI2cBus bus;
+  bus.useManualClock();
+  SimulatedSrf08 &device{bus.add(0x70)};
+  device.setTargets({1.0f, 3.0f});
+  Srf08 sensor{bus, Srf08Config{0x70, 0, 255, 31, 2}};
+  REQUIRE(device.rangingTime() > std::chrono::milliseconds{64});
+  REQUIRE(device.rangingTime() < std::chrono::milliseconds{66});
+
+  /* (47 + 1) * 43 mm is a window of about 2 m. */
+  REQUIRE(sensor.writeRange(47));
+  REQUIRE(device.range() == 47);
+  REQUIRE(device.rangingTime() < std::chrono::milliseconds{13});
+  REQUIRE(sensor.startRanging());
+  bus.advance(device.rangingTime());
+  Srf08Echoes echoes;
+  REQUIRE(sensor.readEchoes(echoes));
+  REQUIRE(echoes.count == 1);
+  REQUIRE(echoes.distances[0] == Approx(1.0f));
+}
+
+TEST_CASE("Test firing schedule separates interfering sensors") {
+  /* 0 - 1 - 2 form a chain, and 3 interferes with nobody. */
+  FiringSchedule schedule{4};
+  REQUIRE(schedule.addInterference(0, 1));
+  REQUIRE(schedule.addInterference(1, 2));
+  REQUIRE_FALSE(schedule.addInterference(2, 2));
+  REQUIRE_FALSE(schedule.addInterference(2, 4));
+  schedule.build();
+  REQUIRE(schedule.slotCount() == 2);
+  REQUIRE((schedule.slotMask(0) & schedule.slotMask(1)) == 0);
+  REQUIRE((schedule.slotMask(1) & schedule.slotMask(2)) == 0);
+  REQUIRE(schedule.slotMask(0) == schedule.slotMask(2));
+  REQUIRE(schedule.slotMask(3) == 0x3);
+  REQUIRE(schedule.rate(0, 20.0f) == Approx(10.0f));
+  REQUIRE(schedule.rate(3, 20.0f) == Approx(20.0f));
+}
+
+TEST_CASE("Test firing schedule uses the fewest slots") {
+  /* An odd ring needs three slots. */
+  FiringSchedule ring{5};
+  for (uint32_t i = 0; i < 5; i++) {
+    REQUIRE(ring.addInterference(i, (i + 1) % 5));
+  }
+  ring.build();
+  REQUIRE(ring.slotCount() == 3);
+
+  /* A crown graph is two-colourable, but greedy colouring in index order
+   * needs one slot per pair. */
+  FiringSchedule crown{8};
+  for (uint32_t i = 0; i < 4; i++) {
+    for (uint32_t j = 0; j < 4; j++) {
+      if (i != j) {
+        crown.addInterference(2 * i, 2 * j + 1);
+      }
+    }
+  }
+  crown.build();
+  REQUIRE(crown.slotCount() == 2);
+
+  FiringSchedule none{3};
+  none.build();
+  REQUIRE(none.slotCount() == 1);
+  REQUIRE(none.rate(2, 10.0f) == Approx(10.0f));
+}
+
+TEST_CASE("Test SRF08 array fires only the sensors of a slot") {
+  SimulatedI2cBus bus;
+  bus.useManualClock();
+  Srf08Array array{bus};
+  for (uint8_t i = 0; i < 3; i++) {
+    bus.add(static_cast<uint8_t>(0x70 + i));
+    array.add(Srf08Config{static_cast<uint8_t>(0x70 + i), i, 255, 31, 1});
+  }
+  array.setSlotMask(0, 0x1);
+  array.setSlotMask(1, 0x2);
+  array.setSlotMask(2, 0x3);
+
+  REQUIRE(array.fire(0) == 0);
+  REQUIRE(array.state(0) == Srf08Array::State::Ranging);
+  REQUIRE(array.state(1) == Srf08Array::State::Idle);
+  REQUIRE(array.state(2) == Srf08Array::State::Ranging);
+  bus.advance(std::chrono::milliseconds{70});
+  array.waitForRanging(std::chrono::milliseconds{0},
+                       std::chrono::milliseconds{0});
+  REQUIRE(array.collect(nullptr) == 0);
+  REQUIRE(array.fire(1) == 0);
+  REQUIRE(bus.device(0x70)->pings() == 1);
+  REQUIRE(bus.device(0x71)->pings() == 1);
+  REQUIRE(bus.device(0x72)->pings() == 2);
+}
+
+TEST_CASE("Test SRF08 array broadcast fires all sensors at once") {
+  SimulatedI2cBus bus;
+  bus.useManualClock();
+  Srf08Array array{bus};
+  for (uint8_t i = 0; i < 4; i++) {
+    bus.add(static_cast<uint8_t>(0x70 + i)).setTargets({1.0f + i});
+    array.add(Srf08Config{static_cast<uint8_t>(0x70 + i), i, 255, 31, 1});
+  }
+  uint64_t const before{bus.transactions()};
+  REQUIRE(array.fireBroadcast() == 0);
+  REQUIRE(bus.transactions() == before + 1);
+  bus.advance(std::chrono::milliseconds{70});
+  REQUIRE(array.waitForRanging(std::chrono::milliseconds{0},
+                               std::chrono::milliseconds{0}) == 0);
+
+  std::vector<std::chrono::system_clock::time_point> fireTimes;
+  float distance[4]{};
+  REQUIRE(array.collect([&](Srf08 &sensor, Srf08Echoes const &echoes) {
+    fireTimes.push_back(echoes.fireTime);
+    distance[sensor.id()] = echoes.distances[0];
+  }) == 0);
+  REQUIRE(fireTimes.size() == 4);
+  for (auto const &fireTime : fireTimes) {
+    REQUIRE(fireTime == fireTimes[0]);
+  }
+  REQUIRE(distance[3] == Approx(4.0f));
+  for (uint8_t i = 0; i < 4; i++) {
+    REQUIRE(bus.device(static_cast<uint8_t>(0x70 + i))->pings() == 1);
+  }
+}
+
+TEST_CASE("Test bus acquisitions run their buses in parallel") {
+  AcquisitionOptions options;
+  options.freq = 100.0f;
+  options.poll = true;
+  options.pollInterval = std::chrono::milliseconds{1};
+  options.pollTimeout = std::chrono::milliseconds{20};
+
+  /* A range of 10 gives a ranging time of under 3 ms. After its first
+   * cycle, each bus waits for the other one to get there as well, which
+   * only happens when both run at the same time. The timeout only ends a
+   * failing test. */
+  SimulatedI2cBus buses[2];
+  std::unique_ptr<BusAcquisition> acquisitions[2];
+  std::atomic<uint32_t> readings[2]{{0}, {0}};
+  std::atomic<uint32_t> arrived{0};
+  bool met[2]{false, false};
+  uint32_t cycles[2]{0, 0};
+  for (uint32_t b = 0; b < 2; b++) {
+    buses[b].add(0x70).setTargets({0.2f});
+    acquisitions[b].reset(new BusAcquisition{buses[b], options});
+    acquisitions[b]->array().add(Srf08Config{0x70, b, 10, 31, 1});
+    REQUIRE(acquisitions[b]->array().sensors()[0]->writeRange(10));
+  }
+  for (uint32_t b = 0; b < 2; b++) {
+    std::atomic<uint32_t> &count = readings[b];
+    uint32_t &cycle = cycles[b];
+    bool &other = met[b];
+    acquisitions[b]->start(
+        [&count](Srf08 &, Srf08Echoes const &echoes) {
+          if (echoes.count == 1) {
+            count++;
+          }
+        },
+        [&cycle, &other, &arrived]() {
+          if (++cycle == 1) {
+            arrived++;
+            auto const timeout{std::chrono::steady_clock::now() +
+                               std::chrono::seconds{5}};
+            while (arrived.load() < 2 &&
+                   std::chrono::steady_clock::now() < timeout) {
+              std::this_thread::sleep_for(std::chrono::microseconds{100});
+            }
+            other = arrived.load() == 2;
+          }
+          return cycle < 5;
+        });
+  }
+  for (uint32_t b = 0; b < 2; b++) {
+    acquisitions[b]->join();
+    REQUIRE(met[b]);
+    REQUIRE(acquisitions[b]->scheduler().cycles() == 5);
+    REQUIRE(readings[b].load() == 5);
+    REQUIRE(buses[b].device(0x70)->pings() == 5);
+  }
+}
+
+TEST_CASE("Test a simulated acquisition cycle does not allocate") {
+  SimulatedI2cBus bus;
+  bus.useManualClock();
+  Srf08Array array{bus};
+  for (uint8_t i = 0; i < 12; i++) {
+    bus.add(static_cast<uint8_t>(0x70 + i)).setTargets({0.3f + 0.1f * i});
+    array.add(Srf08Config{static_cast<uint8_t>(0x70 + i), i, 255, 31, 1});
+  }
+  EnvelopeEncoder encoder;
+  uint32_t length{0};
+  auto const publish{[&](Srf08 &sensor, Srf08Echoes const &echoes) {
+    cluon::data::TimeStamp const now{cluon::time::now()};
+    encoder.payload(opendlv::proxy::DistanceReading::ID())
+        .writeFloat(1, echoes.distances[0]);
+    length += encoder.encode(now, now, sensor.id());
+  }};
+  std::function<void(Srf08 &, Srf08Echoes const &)> const delegate{publish};
+  auto cycle{[&]() {
+    array.fire();
+    bus.advance(std::chrono::milliseconds{70});
+    array.waitForRanging(std::chrono::milliseconds{0},
+                         std::chrono::milliseconds{0});
+    array.collect(delegate);
+  }};
+  cycle();
+
+  uint64_t const before{g_allocations.load()};
+  for (uint32_t i = 0; i < 1000; i++) {
+    cycle();
+  }
+  REQUIRE(g_allocations.load() == before);
+  REQUIRE(length > 0);
+
+  BENCHMARK("Simulated acquisition cycle of 12 sensors") {
+    cycle();
+  }
+}
+
+TEST_CASE("Test SPSC ring keeps order and refuses to overflow") {
+  SpscRing<uint32_t, 4> ring;
+  uint32_t value{0};
+  REQUIRE_FALSE(ring.pop(value));
+  for (uint32_t i = 0; i < 4; i++) {
+    REQUIRE(ring.push(i));
+  }
+  REQUIRE_FALSE(ring.push(4));
+  REQUIRE(ring.size() == 4);
+  for (uint32_t i = 0; i < 6; i++) {
+    REQUIRE(ring.pop(value));
+    REQUIRE(value == i);
+    REQUIRE(ring.push(i + 4));
+  }
+  REQUIRE(ring.size() == 4);
+}
+
+TEST_CASE("Test publisher thread delivers queued readings and counts "
+          "overflows") {
+  std::vector<uint32_t> delivered;
+  std::atomic<bool> blocked{true};
+  {
+    PublisherThread publisherThread{2, [&](QueuedReading const &reading) {
+                                      while (blocked.load()) {
+                                        std::this_thread::yield();
+                                      }
+                                      delivered.push_back(reading.id);
+                                    }};
+    QueuedReading reading;
+    /* The publisher takes at most one reading out while blocked, so the
+     * ring of producer 0 overflows. */
+    uint32_t accepted{0};
+    for (uint32_t i = 0; i < PublisherThread::RING_CAPACITY + 10; i++) {
+      reading.id = i;
+      accepted += publisherThread.push(0, reading) ? 1 : 0;
+    }
+    reading.id = 1000;
+    REQUIRE(publisherThread.push(1, reading));
+    REQUIRE(publisherThread.overflows(0) ==
+            PublisherThread::RING_CAPACITY + 10 - accepted);
+    REQUIRE(publisherThread.overflows(0) >= 9);
+    REQUIRE(publisherThread.overflows(1) == 0);
+    blocked.store(false);
+    publisherThread.stop();
+    REQUIRE(publisherThread.published() == accepted + 1);
+  }
+  REQUIRE(delivered.size() > PublisherThread::RING_CAPACITY);
+  REQUIRE(std::find(delivered.begin(), delivered.end(), 1000) !=
+          delivered.end());
+  for (uint32_t i = 1; i < delivered.size(); i++) {
+    REQUIRE((delivered[i] > delivered[i - 1] || delivered[i] == 1000 ||
+             delivered[i - 1] == 1000));
+  }
+}
+
+TEST_CASE("Test sliding median matches sorting the window") {
+  std::mt19937 generator{42};
+  std::uniform_int_distribution<int32_t> distribution{0, 20};
+  for (uint32_t window = 1; window <= 9; window++) {
+    SlidingMedian median{window};
+    std::vector<float> history;
+    for (uint32_t i = 0; i < 200; i++) {
+      float const value{static_cast<float>(distribution(generator))};
+      median.push(value);
+      history.push_back(value);
+      std::vector<float> sorted{
+          history.end() - std::min<int64_t>(history.size(), window),
+          history.end()};
+      std::sort(sorted.begin(), sorted.end());
+      uint32_t const n{static_cast<uint32_t>(sorted.size())};
+      float const expected{(n % 2 == 1)
+                               ? sorted[n / 2]
+                               : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0f};
+      REQUIRE(median.size() == n);
+      REQUIRE(median.median() == Approx(expected));
+    }
+  }
+}
+
+TEST_CASE("Test rolling filters reject single-sample spikes") {
+  float const distances[8]{1.00f, 1.02f, 0.98f, 1.01f,
+                           0.20f, 0.99f, 1.00f, 1.03f};
+  RollingFilter median{RollingFilter::Type::Median, 3, 3.0f};
+  RollingFilter hampel{RollingFilter::Type::Hampel, 5, 3.0f};
+  uint64_t const before{g_allocations.load()};
+  for (uint32_t i = 0; i < 8; i++) {
+    float const m{median.filter(distances[i])};
+    float const h{hampel.filter(distances[i])};
+    REQUIRE(m > 0.9f);
+    REQUIRE(h > 0.9f);
+    if (i != 4) {
+      /* Hampel passes inliers through unchanged. */
+      REQUIRE(h == Approx(distances[i]));
+    }
+  }
+  REQUIRE(g_allocations.load() == before);
+
+  RollingFilter::Type type{RollingFilter::Type::Median};
+  REQUIRE(RollingFilter::parseType("hampel", type));
+  REQUIRE(type == RollingFilter::Type::Hampel);
+  REQUIRE_FALSE(RollingFilter::parseType("mean", type));
+}
+
+TEST_CASE("Test range tracker estimates the closing speed") {
+  RangeTracker tracker{0.01f, 1.0f, std::chrono::seconds{1}};
+  RangeTracker::TimePoint time{std::chrono::seconds{100}};
+  REQUIRE_FALSE(tracker.predict(time));
+  REQUIRE_FALSE(tracker.isTracking());
+
+  /* An object approaching at 0.5 m/s, sampled at irregular intervals and
+   * with every fifth sample dropped. */
+  float distance{4.0f};
+  std::chrono::milliseconds const intervals[3]{std::chrono::milliseconds{60},
+                                               std::chrono::milliseconds{85},
+                                               std::chrono::milliseconds{70}};
+  for (uint32_t i = 0; i < 60; i++) {
+    auto const dt{intervals[i % 3]};
+    time += dt;
+    distance -= 0.5f * std::chrono::duration<float>(dt).count();
+    if (i % 5 == 4) {
+      REQUIRE(tracker.predict(time));
+    } else {
+      REQUIRE(tracker.update(time, distance));
+    }
+  }
+  RangeTrack const track{tracker.track()};
+  REQUIRE(track.distance == Approx(distance).margin(0.01));
+  REQUIRE(track.closingSpeed == Approx(0.5f).margin(0.05));
+  REQUIRE(track.distanceVariance > 0.0f);
+  REQUIRE(track.distanceVariance < 0.001f);
+  REQUIRE(track.closingSpeedVariance > 0.0f);
+
+  /* A spike is rejected, and coasting widens the covariance until the
+   * track is dropped. */
+  time += std::chrono::milliseconds{70};
+  REQUIRE_FALSE(tracker.update(time, distance - 1.0f));
+  time += std::chrono::milliseconds{500};
+  REQUIRE(tracker.predict(time));
+  REQUIRE(tracker.track().distanceVariance > track.distanceVariance);
+  time += std::chrono::milliseconds{600};
+  REQUIRE_FALSE(tracker.predict(time));
+  REQUIRE_FALSE(tracker.isTracking());
+  REQUIRE(tracker.update(time, 1.0f));
+  REQUIRE(tracker.track().distance == Approx(1.0f));
+}
+
+TEST_CASE("Test gain and range control shrinks the window to the echoes") {
+  GainRangeController controller{255, 31, 10};
+  REQUIRE(controller.range() == 255);
+  REQUIRE(controller.gain() == 31);
+  REQUIRE(GainRangeController::rangeWindow(
+              GainRangeController::rangeRegister(2.0f)) >= 2.0f);
+
+  Srf08Echoes echoes;
+  echoes.count = 2;
+  echoes.distances[0] = 1.0f;
+  echoes.distances[1] = 1.6f;
+  for (uint32_t i = 0; i < 10; i++) {
+    controller.observe(echoes);
+  }
+  float const window{GainRangeController::rangeWindow(controller.range())};
+  REQUIRE(window >= 1.6f * 1.25f + 0.3f);
+  REQUIRE(window < 2.5f);
+  REQUIRE(controller.gain() == 31);
+
+  /* An echo near the end of the window opens it fully. */
+  echoes.distances[1] = 0.9f * window;
+  for (uint32_t i = 0; i < 10; i++) {
+    controller.observe(echoes);
+  }
+  REQUIRE(controller.range() == 255);
+
+  /* Every PROBE_INTERVAL-th window is a full one. */
+  echoes.distances[1] = 1.6f;
+  uint32_t fullWindows{0};
+  for (uint32_t w = 2; w < 2 + GainRangeController::PROBE_INTERVAL; w++) {
+    for (uint32_t i = 0; i < 10; i++) {
+      controller.observe(echoes);
+    }
+    fullWindows += (controller.range() == 255) ? 1 : 0;
+  }
+  REQUIRE(fullWindows == 1);
+}
+
+TEST_CASE("Test gain control backs off in clutter and recovers") {
+  GainRangeController controller{255, 31, 10};
+  Srf08Echoes echoes;
+  echoes.count = 1;
+  for (uint32_t i = 0; i < 20; i++) {
+    echoes.distances[0] = (i % 2 == 0) ? 0.3f : 2.0f;
+    controller.observe(echoes);
+  }
+  REQUIRE(controller.gain() < 31);
+  uint8_t const lowered{controller.gain()};
+
+  /* A stable scene where most pings see nothing brings the gain back up,
+   * but never above the configured one. */
+  echoes.distances[0] = 2.0f;
+  for (uint32_t i = 0; i < 200; i++) {
+    echoes.count = (i % 4 == 0) ? 1 : 0;
+    controller.observe(echoes);
+  }
+  REQUIRE(controller.gain() > lowered);
+  REQUIRE(controller.gain() == 31);
+}
+
+TEST_CASE("Test adaptive acquisition writes the controlled range") {
+  AcquisitionOptions options;
+  options.freq = 50.0f;
+  options.poll = true;
+  options.pollInterval = std::chrono::milliseconds{1};
+  options.pollTimeout = std::chrono::milliseconds{80};
+  options.adaptive = true;
+  options.adaptiveWindow = 2;
+
+  SimulatedI2cBus bus;
+  bus.add(0x70).setTargets({0.5f});
+  BusAcquisition acquisition{bus, options};
+  acquisition.array().add(Srf08Config{0x70, 0, 255, 31, 1});
+  uint32_t readings{0};
+  uint32_t cycles{0};
+  acquisition.start(
+      [&readings](Srf08 &, Srf08Echoes const &echoes) {
+        readings += (echoes.count == 1) ? 1 : 0;
+      },
+      [&cycles]() { return ++cycles < 4; });
+  acquisition.join();
+  REQUIRE(readings == 4);
+  REQUIRE(bus.device(0x70)->range() ==
+          GainRangeController::rangeRegister(1.0f));
+  REQUIRE(acquisition.array().sensors()[0]->range() ==
+          bus.device(0x70)->range());
+  REQUIRE(acquisition.array().rangingTime() < std::chrono::milliseconds{7});
+}
+
+TEST_CASE("Test deadline scheduler changes its frequency between cycles") {
+  DeadlineScheduler scheduler{10.0f, DeadlineScheduler::OverrunPolicy::Skip};
+  uint32_t cycles{0};
+  auto const start{std::chrono::steady_clock::now()};
+  scheduler.run([&scheduler, &cycles]() {
+    if (cycles == 0) {
+      scheduler.setFrequency(1000.0f);
+    }
+    return ++cycles < 21;
+  });
+  auto const elapsed{std::chrono::steady_clock::now() - start};
+  /* The first deadline already follows the new period, where the old one
+   * would take two seconds. */
+  REQUIRE(elapsed >= std::chrono::milliseconds{19});
+  REQUIRE(elapsed < std::chrono::milliseconds{1000});
+}
+
+TEST_CASE("Test speed curve interpolates rate and window") {
+  SpeedCurve curve;
+  REQUIRE(curve.empty());
+  REQUIRE_FALSE(curve.parse("0:2"));
+  REQUIRE_FALSE(curve.parse("2:10:4,1:2:1"));
+  REQUIRE_FALSE(curve.parse("0:0:1"));
+  REQUIRE(curve.empty());
+  REQUIRE(curve.parse("0:2:1.5,2:10:4,8:20:11"));
+  REQUIRE(curve.rate(0.0f) == Approx(2.0f));
+  REQUIRE(curve.rate(1.0f) == Approx(6.0f));
+  REQUIRE(curve.window(5.0f) == Approx(7.5f));
+  REQUIRE(curve.rate(-2.0f) == Approx(10.0f));
+  REQUIRE(curve.rate(30.0f) == Approx(20.0f));
+  REQUIRE(curve.window(30.0f) == Approx(11.0f));
+}
+
+TEST_CASE("Test ground speed moves the bus budget to forward sensors") {
+  SpeedCurve curve;
+  REQUIRE(curve.parse("0:5:1,10:50:2"));
+  AcquisitionOptions options;
+  options.freq = 1.0f;
+  options.poll = true;
+  options.pollInterval = std::chrono::milliseconds{1};
+  options.pollTimeout = std::chrono::milliseconds{20};
+  options.speedCurve = &curve;
+
+  SimulatedI2cBus bus;
+  BusAcquisition acquisition{bus, options};
+  for (uint8_t i = 0; i < 2; i++) {
+    bus.add(static_cast<uint8_t>(0x70 + i)).setTargets({0.5f});
+    acquisition.array().add(
+        Srf08Config{static_cast<uint8_t>(0x70 + i), i, 255, 31, 1});
+  }
+  acquisition.setForwardMask(1U << 0);
+  acquisition.setGroundSpeed(10.0f);
+  uint32_t cycles{0};
+  auto const start{std::chrono::steady_clock::now()};
+  acquisition.start(nullptr, [&cycles]() { return ++cycles < 20; });
+  acquisition.join();
+  auto const elapsed{std::chrono::steady_clock::now() - start};
+
+  /* 20 cycles at 50 Hz instead of 1 Hz, where the other sensor keeps its
+   * standstill rate of 5 Hz. */
+  REQUIRE(elapsed < std::chrono::milliseconds{10000});
+  REQUIRE(bus.device(0x70)->pings() == 20);
+  REQUIRE(bus.device(0x71)->pings() == 2);
+  REQUIRE(bus.device(0x70)->range() ==
+          GainRangeController::rangeRegister(2.0f));
+  REQUIRE(bus.device(0x71)->range() ==
+          GainRangeController::rangeRegister(1.0f));
+}
+
+TEST_CASE("Test long-window rounds interleave with the short window") {
+  AcquisitionOptions options;
+  options.freq = 100.0f;
+  options.poll = true;
+  options.pollInterval = std::chrono::milliseconds{1};
+  options.pollTimeout = std::chrono::milliseconds{80};
+  options.longEvery = 3;
+
+  SimulatedI2cBus bus;
+  bus.add(0x70).setTargets({0.2f});
+  BusAcquisition acquisition{bus, options};
+  acquisition.array().add(Srf08Config{0x70, 0, 10, 31, 1});
+  REQUIRE(acquisition.array().sensors()[0]->writeRange(10));
+  /* Assertions only run on the test thread, after the acquisition. */
+  std::vector<uint8_t> ranges;
+  std::vector<uint8_t> counts;
+  ranges.reserve(6);
+  counts.reserve(6);
+  uint32_t cycles{0};
+  acquisition.start(
+      [&ranges, &counts](Srf08 &, Srf08Echoes const &echoes) {
+        ranges.push_back(echoes.range);
+        counts.push_back(echoes.count);
+      },
+      [&cycles]() { return ++cycles < 6; });
+  acquisition.join();
+  REQUIRE(ranges == std::vector<uint8_t>{10, 10, 255, 10, 10, 255});
+  REQUIRE(counts == std::vector<uint8_t>(6, 1));
+  REQUIRE(bus.device(0x70)->range() == 255);
+  REQUIRE(bus.device(0x70)->pings() == 6);
+}
+
+TEST_CASE("Test a failed restore of the short window is retried") {
+  AcquisitionOptions options;
+  options.freq = 100.0f;
+  options.poll = true;
+  options.pollInterval = std::chrono::milliseconds{1};
+  options.pollTimeout = std::chrono::milliseconds{80};
+  options.longEvery = 3;
+
+  SimulatedI2cBus bus;
+  SimulatedSrf08 &device{bus.add(0x70)};
+  device.setTargets({0.2f});
+  BusAcquisition acquisition{bus, options};
+  acquisition.array().add(Srf08Config{0x70, 0, 10, 31, 1});
+  REQUIRE(acquisition.array().sensors()[0]->writeRange(10));
+  /* The restore after the first long round is NACKed, so the sensor pings
+   * the long window once more, and the short one comes back with the
+   * retry. Later long rounds still return to the short window. */
+  std::vector<uint8_t> ranges;
+  ranges.reserve(7);
+  uint32_t cycles{0};
+  acquisition.start(
+      [&ranges](Srf08 &, Srf08Echoes const &echoes) {
+        ranges.push_back(echoes.range);
+      },
+      [&device, &cycles]() {
+        if (++cycles == 3) {
+          device.nackRangeWrites(1);
+        }
+        return cycles < 7;
+      });
+  acquisition.join();
+  REQUIRE(ranges == std::vector<uint8_t>{10, 10, 255, 255, 10, 255, 10});
+  REQUIRE(device.range() == 10);
+}
+
+TEST_CASE("Test runtime configuration writes only changed registers") {
+  AcquisitionOptions options;
+  options.freq = 100.0f;
+
+  SimulatedI2cBus bus;
+  bus.add(0x70).setTargets({0.2f});
+  BusAcquisition acquisition{bus, options};
+  acquisition.array().add(Srf08Config{0x70, 3, 10, 31, 1});
+  REQUIRE(acquisition.array().sensors()[0]->writeRange(10));
+  REQUIRE(acquisition.configure(SensorConfiguration{4, 20, 5}) ==
+          BusAcquisition::Request::Invalid);
+  REQUIRE(acquisition.configure(SensorConfiguration{3, 256, 5}) ==
+          BusAcquisition::Request::Invalid);
+  REQUIRE(acquisition.configure(SensorConfiguration{3, 20, 32}) ==
+          BusAcquisition::Request::Invalid);
+  REQUIRE(acquisition.configure(SensorConfiguration{3, 0xFFFFFFFF, -1}) ==
+          BusAcquisition::Request::Invalid);
+  /* Requests that change nothing fill the queue until the first firing. */
+  for (uint32_t i = 0; i < BusAcquisition::REQUEST_CAPACITY; i++) {
+    REQUIRE(acquisition.configure(SensorConfiguration{3, -1, -1}) ==
+            BusAcquisition::Request::Queued);
+  }
+  REQUIRE(acquisition.configure(SensorConfiguration{3, 20, 5}) ==
+          BusAcquisition::Request::QueueFull);
+
+  /* Every cycle without a change costs the same bus transactions, and the
+   * first one after a request one more per changed register. Results are
+   * checked on the test thread, after the acquisition. */
+  std::vector<uint64_t> transactions;
+  std::vector<BusAcquisition::Request> requests;
+  transactions.reserve(5);
+  requests.reserve(3);
+  acquisition.start(nullptr, [&]() {
+    transactions.push_back(bus.transactions());
+    if (transactions.size() == 1) {
+      requests.push_back(
+          acquisition.configure(SensorConfiguration{3, 20, -1}));
+      requests.push_back(acquisition.configure(SensorConfiguration{3, -1, 5}));
+    } else if (transactions.size() == 3) {
+      requests.push_back(acquisition.configure(SensorConfiguration{3, 20, 5}));
+    }
+    return transactions.size() < 5;
+  });
+  acquisition.join();
+  REQUIRE(requests == std::vector<BusAcquisition::Request>(
+                          3, BusAcquisition::Request::Queued));
+  REQUIRE(bus.device(0x70)->range() == 20);
+  REQUIRE(bus.device(0x70)->gain() == 5);
+  uint64_t const cycle{transactions[4] - transactions[3]};
+  REQUIRE(transactions[1] - transactions[0] == cycle + 2);
+  REQUIRE(transactions[2] - transactions[1] == cycle);
+  REQUIRE(transactions[3] - transactions[2] == cycle);
+}
+
+TEST_CASE("Test a request for all sensors of a bus takes one entry") {
+  AcquisitionOptions options;
+  options.freq = 100.0f;
+
+  SimulatedI2cBus bus;
+  BusAcquisition acquisition{bus, options};
+  for (uint8_t i = 0; i < 3; i++) {
+    bus.add(static_cast<uint8_t>(0x70 + i)).setTargets({0.2f});
+    acquisition.array().add(
+        Srf08Config{static_cast<uint8_t>(0x70 + i), i, 10, 31, 1});
+    REQUIRE(acquisition.array().sensors()[i]->writeRange(10));
+  }
+  /* Whether a request names a sensor or all of them, later ones win. */
+  REQUIRE(acquisition.configure(SensorConfiguration{1, 30, -1}) ==
+          BusAcquisition::Request::Queued);
+  REQUIRE(acquisition.configure(SensorConfiguration{-1, 20, 5}) ==
+          BusAcquisition::Request::Queued);
+  REQUIRE(acquisition.configure(SensorConfiguration{2, 40, -1}) ==
+          BusAcquisition::Request::Queued);
+  for (uint32_t i = 3; i < BusAcquisition::REQUEST_CAPACITY; i++) {
+    REQUIRE(acquisition.configure(SensorConfiguration{-1, -1, 7}) ==
+            BusAcquisition::Request::Queued);
+  }
+  REQUIRE(acquisition.configure(SensorConfiguration{-1, 20, 5}) ==
+          BusAcquisition::Request::QueueFull);
+
+  uint32_t cycles{0};
+  acquisition.start(nullptr, [&cycles]() { return ++cycles < 1; });
+  acquisition.join();
+  REQUIRE(bus.device(0x70)->range() == 20);
+  REQUIRE(bus.device(0x71)->range() == 20);
+  REQUIRE(bus.device(0x72)->range() == 40);
+  for (uint8_t i = 0; i < 3; i++) {
+    REQUIRE(bus.device(static_cast<uint8_t>(0x70 + i))->gain() == 7);
+  }
+}
+
+TEST_CASE("Test the fixed ranging wait follows the range register") {
+  AcquisitionOptions options;
+  options.freq = 100.0f;
+
+  /* Without polling, a read before the ranging time has passed would be
+   * ignored by the simulated sensor, so every echo shows that the wait
+   * covered the window set at runtime. */
+  SimulatedI2cBus bus;
+  bus.add(0x70).setTargets({0.2f});
+  BusAcquisition acquisition{bus, options};
+  acquisition.array().add(Srf08Config{0x70, 0, 10, 31, 1});
+  REQUIRE(acquisition.array().sensors()[0]->writeRange(10));
+  std::vector<uint8_t> ranges;
+  std::vector<uint8_t> counts;
+  ranges.reserve(4);
+  counts.reserve(4);
+  uint32_t cycles{0};
+  acquisition.start(
+      [&ranges, &counts](Srf08 &, Srf08Echoes const &echoes) {
+        ranges.push_back(echoes.range);
+        counts.push_back(echoes.count);
+      },
+      [&acquisition, &cycles]() {
+        if (++cycles == 2) {
+          acquisition.configure(SensorConfiguration{0, 255, -1});
+        }
+        return cycles < 4;
+      });
+  acquisition.join();
+  REQUIRE(ranges == std::vector<uint8_t>{10, 10, 255, 255});
+  REQUIRE(counts == std::vector<uint8_t>(4, 1));
+  REQUIRE(acquisition.array().rangingTime() >
+          std::chrono::milliseconds{64});
+}
+
+TEST_CASE("Test datagram batch keeps one container per datagram") {
+  EnvelopeEncoder encoder;
+  DatagramBatch batch;
+  struct sockaddr_in address {};
+  cluon::data::TimeStamp const now{cluon::time::now()};
+  for (uint32_t i = 0; i < DatagramBatch::MAX_DATAGRAMS; i++) {
+    encoder.payload(opendlv::proxy::DistanceReading::ID())
+        .writeFloat(1, 0.1f * static_cast<float>(i));
+    uint32_t const length{encoder.encode(now, now, i)};
+    REQUIRE(batch.add(encoder.data(), length));
+  }
+  REQUIRE(batch.full());
+  REQUIRE_FALSE(batch.add(encoder.data(), 1));
+
+  struct mmsghdr const *messages{batch.messages(&address)};
+  for (uint32_t i = 0; i < batch.size(); i++) {
+    REQUIRE(messages[i].msg_hdr.msg_name == &address);
+    REQUIRE(messages[i].msg_hdr.msg_iov->iov_base == batch.data(i));
+    std::stringstream stream{std::string(
+        reinterpret_cast<char const *>(batch.data(i)), batch.length(i))};
+    auto const envelope{cluon::extractEnvelope(stream)};
+    REQUIRE(envelope.first);
+    REQUIRE(envelope.second.senderStamp() == i);
+  }
+  batch.clear();
+  REQUIRE(batch.size() == 0);
+}
+
+TEST_CASE("Test publisher thread does not count end-of-cycle marks") {
+  std::atomic<uint32_t> marks{0};
+  PublisherThread publisherThread{1, [&marks](QueuedReading const &reading) {
+                                    marks += reading.endOfCycle ? 1 : 0;
+                                  }};
+  QueuedReading reading;
+  REQUIRE(publisherThread.push(0, reading));
+  reading.endOfCycle = true;
+  REQUIRE(publisherThread.push(0, reading));
+  publisherThread.stop();
+  REQUIRE(marks.load() == 1);
+  REQUIRE(publisherThread.published() == 1);
+}
+
+TEST_CASE("Test the acquisition and publishing loop does not allocate") {
+  AcquisitionOptions options;
+  options.freq = 100.0f;
+  options.poll = true;
+  options.pollInterval = std::chrono::milliseconds{1};
+  options.pollTimeout = std::chrono::milliseconds{20};
+
+  /* The whole loop of the microservice: a bus thread on simulated sensors
+   * queues its readings, and the publisher thread encodes and batches
+   * them, sending each cycle with one sendmmsg call. Allocations of every
+   * thread are counted from the end of the warm-up until both are done. */
+  SimulatedI2cBus bus;
+  BusAcquisition acquisition{bus, options};
+  for (uint8_t i = 0; i < 4; i++) {
+    bus.add(static_cast<uint8_t>(0x70 + i)).setTargets({0.3f + 0.1f * i});
+    acquisition.array().add(
+        Srf08Config{static_cast<uint8_t>(0x70 + i), i, 10, 31, 2});
+    REQUIRE(acquisition.array().sensors()[i]->writeRange(10));
+  }
+  Od4Publisher publisher{111, true};
+  REQUIRE(publisher.isOpen());
+  EnvelopeEncoder encoder;
+  PublisherThread publisherThread{
+      1, [&publisher, &encoder](QueuedReading const &reading) {
+        if (reading.endOfCycle) {
+          publisher.flush();
+          return;
+        }
+        Srf08Echoes const &val = reading.echoes;
+        cluon::data::TimeStamp const sampleTime{
+            cluon::time::convert(Srf08::reflectionTime(
+                val.fireTime, val.distances[0], val.speedOfSound))};
+        publisher.sendDistance(encoder, val.distances[0], sampleTime,
+                               reading.id);
+        publisher.sendEchoes(encoder, val, sampleTime, reading.id);
+      }};
+
+  uint32_t const warmUp{5};
+  uint32_t const total{50};
+  uint32_t cycles{0};
+  uint64_t before{0};
+  uint64_t sendCallsBefore{0};
+  acquisition.start(
+      [&publisherThread](Srf08 &sensor, Srf08Echoes const &val) {
+        QueuedReading reading;
+        reading.id = sensor.id();
+        reading.echoes = val;
+        publisherThread.push(0, reading);
+      },
+      [&]() {
+        QueuedReading endOfCycle;
+        endOfCycle.endOfCycle = true;
+        publisherThread.push(0, endOfCycle);
+        if (++cycles == warmUp) {
+          /* Let the publisher send the warm-up cycles first. */
+          while (publisher.sendCalls() < warmUp) {
+            std::this_thread::yield();
+          }
+          before = g_allocations.load();
+          sendCallsBefore = publisher.sendCalls();
+        }
+        return cycles < total;
+      });
+  acquisition.join();
+  publisherThread.stop();
+  uint64_t const allocations{g_allocations.load() - before};
+
+  REQUIRE(allocations == 0);
+  REQUIRE(publisherThread.published() == 4 * total);
+  REQUIRE(publisherThread.overflows(0) == 0);
+  /* One sendmmsg call per cycle carries the two containers of each of the
+   * four sensors. */
+  REQUIRE(publisher.sendCalls() - sendCallsBefore == total - warmUp);
+}